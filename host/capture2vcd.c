@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Turns a kb6 event capture into a VCD file for GTKWave. The capture
+// comes from a file written by kbsim -c, or straight from a keyboard
+// over the debug interface's hidraw node on Linux.
+
+#include "capture.h"
+#include "keytrace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#endif
+
+#define REPORT_ID_CAPTURE 1 // tinyusb_kb/usb_descriptors.h
+
+static struct capture_event *events;
+static unsigned event_count;
+
+static bool load_file(const char *name)
+{
+    FILE *f = fopen(name, "rb");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    char magic[8];
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, CAPTURE_MAGIC, 8))
+    {
+        fprintf(stderr, "%s: not a capture file\n", name);
+        fclose(f);
+        return false;
+    }
+    struct capture_event ev;
+    while (fread(&ev, sizeof(ev), 1, f) == 1)
+    {
+        events = realloc(events, (event_count + 1) * sizeof(ev));
+        events[event_count++] = ev;
+    }
+    fclose(f);
+    return true;
+}
+
+static bool save_file(const char *name)
+{
+    FILE *f = fopen(name, "wb");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    fwrite(CAPTURE_MAGIC, 1, 8, f);
+    fwrite(events, sizeof(*events), event_count, f);
+    fclose(f);
+    return true;
+}
+
+#ifdef __linux__
+static bool feature(int fd, bool set, uint8_t buf[1 + CAPTURE_REPORT_LEN])
+{
+    buf[0] = REPORT_ID_CAPTURE;
+    int len = 1 + CAPTURE_REPORT_LEN;
+    if (ioctl(fd, set ? HIDIOCSFEATURE(len) : HIDIOCGFEATURE(len), buf) < 0)
+    {
+        perror(set ? "HIDIOCSFEATURE" : "HIDIOCGFEATURE");
+        return false;
+    }
+    return true;
+}
+
+static bool command(int fd, uint8_t cmd, uint32_t offset)
+{
+    uint8_t buf[1 + CAPTURE_REPORT_LEN] = {0};
+    buf[1] = cmd;
+    for (int i = 0; i < 4; i++)
+        buf[2 + i] = offset >> (8 * i);
+    return feature(fd, true, buf);
+}
+
+// Capture for up to ms milliseconds, or until the buffer fills,
+// then read it all back 56 bytes at a time.
+static bool load_device(const char *name, unsigned ms)
+{
+    int fd = open(name, O_RDWR);
+    if (fd < 0)
+    {
+        perror(name);
+        return false;
+    }
+    uint8_t buf[1 + CAPTURE_REPORT_LEN];
+    bool ok = command(fd, CAPTURE_CMD_START, 0);
+    fprintf(stderr, "capturing for up to %ums\n", ms);
+    for (unsigned t = 0; ok && t < ms; t += 10)
+    {
+        usleep(10000);
+        ok = feature(fd, false, buf);
+        if (ok && !buf[1])
+            break; // buffer full
+    }
+    ok = ok && command(fd, CAPTURE_CMD_STOP, 0) && command(fd, CAPTURE_CMD_SEEK, 0);
+    uint8_t *bytes = NULL;
+    size_t size = 0;
+    while (ok && (ok = feature(fd, false, buf)) && buf[2])
+    {
+        bytes = realloc(bytes, size + buf[2]);
+        memcpy(bytes + size, &buf[9], buf[2]);
+        size += buf[2];
+    }
+    close(fd);
+    events = (struct capture_event *)bytes;
+    event_count = size / sizeof(struct capture_event);
+    return ok;
+}
+#endif
+
+// VCD identifiers are short strings of printable characters.
+static const char *vcd_id(unsigned n)
+{
+    static char ids[8][8];
+    static unsigned next;
+    char *id = ids[next++ % 8];
+    int i = 0;
+    do
+    {
+        id[i++] = '!' + n % 94;
+        n /= 94;
+    } while (n);
+    id[i] = 0;
+    return id;
+}
+
+enum
+{
+    VCD_ROWS = 0,     // + column, 16 bits
+    VCD_KEY = 32,     // + cbmcode
+    VCD_GHOST = 288,  // + cbmcode
+    VCD_REPORT = 544, // 56 bits, modifier then 6 keycodes
+    VCD_SENT = 545,   // event at each report
+};
+
+static void key_name(char *buf, size_t len, const char *prefix, unsigned idx)
+{
+    if (idx < sizeof(cbm_key_names) / sizeof(cbm_key_names[0]))
+        snprintf(buf, len, "%s_%s", prefix, cbm_key_names[idx]);
+    else
+        snprintf(buf, len, "%s_%u", prefix, idx);
+}
+
+static void binary(FILE *f, uint64_t value, int bits, const char *id)
+{
+    fputc('b', f);
+    for (int i = bits - 1; i >= 0; i--)
+        fputc('0' + ((value >> i) & 1), f);
+    fprintf(f, " %s\n", id);
+}
+
+static void write_vcd(FILE *f)
+{
+    bool rows[32] = {false}, keys[256] = {false}, ghosts[256] = {false};
+    for (unsigned i = 0; i < event_count; i++)
+    {
+        const struct capture_event *ev = &events[i];
+        if (ev->type == CAPTURE_ROWS && ev->idx < 32)
+            rows[ev->idx] = true;
+        if (ev->type == CAPTURE_KEY && ev->data)
+            keys[ev->idx] = true;
+        if (ev->type == CAPTURE_GHOST && ev->data)
+            ghosts[ev->idx] = true;
+    }
+
+    char name[32];
+    fprintf(f, "$comment cbm2usb kb6 capture, %u events $end\n", event_count);
+    fprintf(f, "$timescale 1us $end\n$scope module cbm2usb $end\n");
+    for (unsigned col = 0; col < 32; col++)
+        if (rows[col])
+            fprintf(f, "$var wire 16 %s rows_c%u $end\n", vcd_id(VCD_ROWS + col), col);
+    for (unsigned idx = 0; idx < 256; idx++)
+        if (keys[idx])
+        {
+            key_name(name, sizeof(name), "key", idx);
+            fprintf(f, "$var wire 1 %s %s $end\n", vcd_id(VCD_KEY + idx), name);
+        }
+    for (unsigned idx = 0; idx < 256; idx++)
+        if (ghosts[idx])
+        {
+            key_name(name, sizeof(name), "ghost", idx);
+            fprintf(f, "$var wire 1 %s %s $end\n", vcd_id(VCD_GHOST + idx), name);
+        }
+    fprintf(f, "$var wire 56 %s report $end\n", vcd_id(VCD_REPORT));
+    fprintf(f, "$var event 1 %s report_sent $end\n", vcd_id(VCD_SENT));
+    fprintf(f, "$upscope $end\n$enddefinitions $end\n");
+
+    // Timestamps are 32 bit microseconds from the start of capture.
+    uint64_t now = 0, last = UINT64_MAX;
+    uint8_t report[7] = {0};
+    uint32_t prev_us = event_count ? events[0].us : 0;
+    for (unsigned i = 0; i < event_count; i++)
+    {
+        const struct capture_event *ev = &events[i];
+        now += (uint32_t)(ev->us - prev_us);
+        prev_us = ev->us;
+        if (now != last)
+        {
+            fprintf(f, "#%llu\n", (unsigned long long)now);
+            last = now;
+        }
+        switch (ev->type)
+        {
+        case CAPTURE_ROWS:
+            if (ev->idx < 32)
+                binary(f, ev->data, 16, vcd_id(VCD_ROWS + ev->idx));
+            break;
+        case CAPTURE_KEY:
+            if (keys[ev->idx])
+                fprintf(f, "%u%s\n", ev->data & 1, vcd_id(VCD_KEY + ev->idx));
+            break;
+        case CAPTURE_GHOST:
+            if (ghosts[ev->idx])
+                fprintf(f, "%u%s\n", ev->data & 1, vcd_id(VCD_GHOST + ev->idx));
+            break;
+        case CAPTURE_REPORT:
+            // modifier, then keycodes in pairs
+            if (ev->idx > 3)
+                break;
+            report[ev->idx * 2] = ev->data;
+            if (ev->idx < 3)
+                report[ev->idx * 2 + 1] = ev->data >> 8;
+            if (ev->idx == 3)
+            {
+                uint64_t value = 0;
+                for (int j = 0; j < 7; j++)
+                    value = value << 8 | report[j];
+                binary(f, value, 56, vcd_id(VCD_REPORT));
+                fprintf(f, "1%s\n", vcd_id(VCD_SENT));
+            }
+            break;
+        }
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: capture2vcd [options] <capture file>\n"
+#ifdef __linux__
+            "       capture2vcd [options] -d /dev/hidrawN\n"
+            "  -d <dev>    capture from a keyboard's debug interface\n"
+            "  -t <ms>     longest time to capture (default 5000)\n"
+            "  -b <file>   also save the capture file\n"
+#endif
+            "  -o <file>   VCD output (default stdout)\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in_name = NULL, *dev_name = NULL, *out_name = NULL, *bin_name = NULL;
+    unsigned ms = 5000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_name = argv[++i];
+#ifdef __linux__
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            dev_name = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            ms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            bin_name = argv[++i];
+#endif
+        else if (argv[i][0] == '-' || in_name)
+            usage();
+        else
+            in_name = argv[i];
+    }
+    if (!in_name == !dev_name)
+        usage();
+
+#ifdef __linux__
+    if (dev_name && !load_device(dev_name, ms))
+        return 1;
+#endif
+    if (in_name && !load_file(in_name))
+        return 1;
+    if (bin_name && !save_file(bin_name))
+        return 1;
+
+    FILE *out = stdout;
+    if (out_name && !(out = fopen(out_name, "w")))
+    {
+        perror(out_name);
+        return 1;
+    }
+    write_vcd(out);
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%u events\n", event_count);
+    return 0;
+}
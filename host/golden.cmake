@@ -0,0 +1,39 @@
+# Runs kbsim over each golden trace and compares the report stream
+# with the .golden file next to it. UPDATE rewrites the .golden files
+# after a deliberate change in output. TRACE runs just the one.
+#   cmake -DKBSIM=kbsim_kb6 -DGOLDEN=host/golden [-DUPDATE=ON] -P golden.cmake
+#   cmake -DKBSIM=kbsim_kb6 -DGOLDEN=host/golden -DTRACE=shift_zero -P golden.cmake
+
+if(TRACE)
+    set(traces ${GOLDEN}/${TRACE}.txt)
+else()
+    file(GLOB traces ${GOLDEN}/*.txt)
+endif()
+set(failed 0)
+foreach(trace ${traces})
+    get_filename_component(name ${trace} NAME_WE)
+    set(expected ${GOLDEN}/${name}.golden)
+    set(actual ${CMAKE_CURRENT_BINARY_DIR}/${name}.golden)
+    execute_process(COMMAND ${KBSIM} -g ${actual} ${trace}
+        OUTPUT_QUIET RESULT_VARIABLE result)
+    if(result)
+        message(SEND_ERROR "${name}: kbsim failed")
+        math(EXPR failed "${failed} + 1")
+    elseif(UPDATE)
+        configure_file(${actual} ${expected} COPYONLY)
+        message(STATUS "${name}: updated")
+    else()
+        file(READ ${expected} want)
+        file(READ ${actual} got)
+        if(want STREQUAL got)
+            message(STATUS "${name}: ok")
+        else()
+            execute_process(COMMAND diff -u ${expected} ${actual})
+            message(SEND_ERROR "${name}: reports differ from ${name}.golden")
+            math(EXPR failed "${failed} + 1")
+        endif()
+    endif()
+endforeach()
+if(failed)
+    message(FATAL_ERROR "${failed} golden traces failed")
+endif()
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_HARDWARE_STRUCTS_SYSTICK_H
+#define _HOST_HARDWARE_STRUCTS_SYSTICK_H
+
+// SysTick for cycle counting. The 24 bit count down runs at 125MHz
+// over simulated waits plus the host time spent in between, so waits
+// cost what they would on a Pico and code costs what it does here.
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t csr;
+    uint32_t rvr;
+    uint32_t cvr;
+    uint32_t calib;
+} systick_hw_t;
+
+systick_hw_t *sim_systick(void);
+#define systick_hw (sim_systick())
+
+#endif
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Typing throughput benchmark. Types BASIC listings into the simulated
+// matrix at increasing words per minute, with the overlap and SHIFT
+// timing of a real typist, decodes the ASCII mode reports back into
+// text and tabulates correct characters per second, errors and latency
+// for each report interval. Each run is forked so the scanner starts
+// from power on every time.
+
+#include "sim.h"
+#include "keytrace.h"
+#include "tusb.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// declares for src/kb*.c
+extern hid_keyboard_modifier_bm_t kb_report(uint8_t keycode[6]);
+extern void kb_init(void);
+extern void kb_task(void);
+extern bool kb_report_pending(void);
+
+// Scanners without a report sequencer only report from hid_task().
+__attribute__((weak)) bool kb_report_pending(void)
+{
+    return false;
+}
+
+#ifndef KBSIM_NAME
+#define KBSIM_NAME "kb"
+#endif
+
+#define POLL_US 1000
+#define LOOP_US 2
+#define MAX_CHARS 4096
+
+static const char corpus[] =
+    "10 print chr$(147);\"hello, world!\"\n"
+    "20 for i=1 to 10:print i;i*i:next i\n"
+    "30 if a<>b then goto 100\n"
+    "40 poke 53280,0:poke 53281,0\n"
+    "50 a$=\"cbm\"+str$(64):print a$\n"
+    "60 input \"your name\";n$\n"
+    "70 data 12,34,56,78,90\n"
+    "80 x=(a+b)*c/d-e^2\n"
+    "90 print \"total: \";t;\" ok?\"\n"
+    "100 rem [the end] @ 1982\n"
+    "the quick brown fox jumps over the lazy dog.\n"
+    "load \"*\",8,1\n"
+    "sys 64738\n";
+
+// How each character is typed in ASCII mode.
+struct stroke
+{
+    uint8_t key;
+    bool shift;
+};
+
+static bool char_stroke(char c, struct stroke *s)
+{
+    static const char *const unshifted[] = {
+        "1234567890", "+-:@*;=,./\n ^"};
+    static const char *const shifted[] = {
+        "!\"#$%&'()", "<>?[]"};
+    static const char *const unshifted_keys[] = {
+        "1", "2", "3", "4", "5", "6", "7", "8", "9", "0",
+        "PLUS", "MINUS", "COLON", "AT", "ASTERISK", "SEMICOLON", "EQUAL",
+        "COMMA", "PERIOD", "SLASH", "RETURN", "SPACE", "UP_ARROW"};
+    static const char *const shifted_keys[] = {
+        "1", "2", "3", "4", "5", "6", "7", "8", "9",
+        "COMMA", "PERIOD", "SLASH", "COLON", "SEMICOLON"};
+    char name[2] = {0};
+    const char *p;
+    s->shift = false;
+    if (c >= 'a' && c <= 'z')
+    {
+        name[0] = c;
+        s->key = cbm_key_lookup(name);
+        return true;
+    }
+    if ((p = strchr(unshifted[0], c)))
+    {
+        s->key = cbm_key_lookup(unshifted_keys[p - unshifted[0]]);
+        return true;
+    }
+    if ((p = strchr(unshifted[1], c)))
+    {
+        s->key = cbm_key_lookup(unshifted_keys[10 + p - unshifted[1]]);
+        return true;
+    }
+    s->shift = true;
+    if ((p = strchr(shifted[0], c)))
+    {
+        s->key = cbm_key_lookup(shifted_keys[p - shifted[0]]);
+        return true;
+    }
+    if ((p = strchr(shifted[1], c)))
+    {
+        s->key = cbm_key_lookup(shifted_keys[9 + p - shifted[1]]);
+        return true;
+    }
+    return false;
+}
+
+// US layout, which is what ASCII mode targets.
+static char hid_char(uint8_t keycode, bool shift)
+{
+    static const char plain[] = "abcdefghijklmnopqrstuvwxyz1234567890\n\0\0\0 -=[]\\\0;'`,./";
+    static const char upper[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ!@#$%^&*()\n\0\0\0 _+{}|\0:\"~<>?";
+    if (keycode < HID_KEY_A || keycode > HID_KEY_SLASH)
+        return 0;
+    return (shift ? upper : plain)[keycode - HID_KEY_A];
+}
+
+static uint32_t rnd_state;
+static uint32_t rnd(uint32_t n)
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return (rnd_state >> 8) % n;
+}
+
+// Average 5 characters per word. Holds are 70-130ms whatever the speed,
+// so faster typing overlaps more keys. SHIFT goes down a little before
+// its key, once the previous key has been down for a moment, and comes
+// up 40-80ms after it, often while the key is still held. Runs of
+// shifted characters share one SHIFT, and the next unshifted key waits
+// for it to be released.
+static unsigned synth_text(struct keytrace *trace, unsigned wpm, uint64_t press_us[])
+{
+    const unsigned LSHIFT = cbm_key_lookup("LSHIFT");
+    uint64_t gap = 60000000ull / (wpm * 5);
+    uint64_t t = 0, last_press = 0, last_up[65] = {0};
+    uint64_t shift_down = 0, shift_up = 0;
+    bool shift_held = false;
+    unsigned count = 0;
+    rnd_state = 0x64 + wpm;
+    for (const char *c = corpus; *c && count < MAX_CHARS; c++)
+    {
+        struct stroke s;
+        if (!char_stroke(*c, &s))
+            continue;
+        t += gap / 2 + rnd(gap);
+        if (s.shift != shift_held)
+        {
+            if (s.shift)
+            {
+                shift_down = MAX(t - MIN(t, 40000), last_press + 15000);
+                shift_down = MAX(shift_down, shift_up + 5000);
+                t = MAX(t, shift_down + 15000);
+            }
+            else
+            {
+                t = MAX(t, shift_up + 10000);
+                keytrace_add(trace, shift_down, LSHIFT, true, 300);
+                keytrace_add(trace, shift_up, LSHIFT, false, 200);
+            }
+            shift_held = s.shift;
+        }
+        // the same key can't go down again until it's back up
+        t = MAX(t, last_up[s.key] + 15000);
+        uint64_t up = t + 70000 + rnd(60000);
+        keytrace_add(trace, t, s.key, true, rnd(800));
+        keytrace_add(trace, up, s.key, false, rnd(500));
+        last_up[s.key] = up;
+        last_press = t;
+        press_us[count++] = t;
+        if (s.shift)
+            shift_up = t + 40000 + rnd(40000);
+    }
+    if (shift_held)
+    {
+        keytrace_add(trace, shift_down, LSHIFT, true, 300);
+        keytrace_add(trace, shift_up, LSHIFT, false, 200);
+    }
+    keytrace_sort(trace);
+    return count;
+}
+
+static bool verbose; // print the decoded text of runs with errors
+static char typed[MAX_CHARS];
+static uint64_t typed_us[MAX_CHARS];
+static unsigned typed_count;
+
+static void decode(hid_keyboard_modifier_bm_t modifier, const uint8_t cur[6], uint64_t now)
+{
+    static uint8_t prev[6];
+    bool shift = modifier & (KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT);
+    if (cur[0] == 1)
+        return; // phantom state
+    for (int i = 0; i < 6; i++)
+        if (cur[i] && !memchr(prev, cur[i], 6) && typed_count < MAX_CHARS)
+        {
+            char c = hid_char(cur[i], shift);
+            typed[typed_count] = c ? c : '?';
+            typed_us[typed_count++] = now;
+        }
+    memcpy(prev, cur, 6);
+}
+
+static void run(const struct keytrace *trace, uint32_t report_us)
+{
+    uint64_t end_us = trace->events[trace->count - 1].us + 500000;
+    uint64_t next_report = 0, next_sequence = 0;
+    unsigned next_event = 0;
+    kb_init();
+    while (sim_now() < end_us)
+    {
+        while (next_event < trace->count && trace->events[next_event].us <= sim_now())
+        {
+            const struct keytrace_event *ev = &trace->events[next_event++];
+            sim_key(ev->key, ev->down, ev->bounce_us);
+        }
+        kb_task();
+        bool timed = sim_now() >= next_report;
+        if (timed || (next_sequence && sim_now() >= next_sequence))
+        {
+            if (timed)
+                next_report = sim_now() + report_us;
+            uint8_t keycode[6] = {0};
+            hid_keyboard_modifier_bm_t modifier = kb_report(keycode);
+            // The IN token follows the next SOF.
+            uint64_t sent = (sim_now() / POLL_US + 1) * POLL_US;
+            decode(modifier, keycode, sent);
+            next_sequence = kb_report_pending() ? sent : 0;
+        }
+        sim_advance(LOOP_US);
+    }
+}
+
+static int u64_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Edit distance alignment of what was typed against what was meant.
+// Matched characters give the latency samples.
+static unsigned align(const char *want, unsigned n, const uint64_t press_us[],
+                      uint64_t lat[], unsigned *lat_count)
+{
+    unsigned m = typed_count;
+    unsigned *d = malloc((n + 1) * (m + 1) * sizeof(unsigned));
+#define D(i, j) d[(i) * (m + 1) + (j)]
+    for (unsigned i = 0; i <= n; i++)
+        D(i, 0) = i;
+    for (unsigned j = 0; j <= m; j++)
+        D(0, j) = j;
+    for (unsigned i = 1; i <= n; i++)
+        for (unsigned j = 1; j <= m; j++)
+        {
+            unsigned sub = D(i - 1, j - 1) + (want[i - 1] != typed[j - 1]);
+            D(i, j) = MIN(sub, MIN(D(i - 1, j), D(i, j - 1)) + 1);
+        }
+    unsigned errors = D(n, m);
+    *lat_count = 0;
+    for (unsigned i = n, j = m; i && j;)
+    {
+        if (want[i - 1] == typed[j - 1] && D(i, j) == D(i - 1, j - 1))
+        {
+            lat[(*lat_count)++] = typed_us[j - 1] - press_us[i - 1];
+            i--, j--;
+        }
+        else if (D(i, j) == D(i - 1, j - 1) + 1)
+            i--, j--;
+        else if (D(i, j) == D(i - 1, j) + 1)
+            i--;
+        else
+            j--;
+    }
+#undef D
+    free(d);
+    return errors;
+}
+
+static void bench(unsigned wpm, uint32_t report_us)
+{
+    static uint64_t press_us[MAX_CHARS], lat[MAX_CHARS];
+    char want[MAX_CHARS];
+    unsigned n = 0;
+    for (const char *c = corpus; *c; c++)
+    {
+        struct stroke s;
+        if (char_stroke(*c, &s))
+            want[n++] = *c;
+    }
+
+    struct keytrace trace = {0};
+    unsigned count = synth_text(&trace, wpm, press_us);
+    sim_reset();
+    // Let power on settle before the first key.
+    for (unsigned i = 0; i < trace.count; i++)
+        trace.events[i].us += 20000;
+    for (unsigned i = 0; i < count; i++)
+        press_us[i] += 20000;
+    run(&trace, report_us);
+
+    unsigned lat_count;
+    unsigned errors = align(want, n, press_us, lat, &lat_count);
+    qsort(lat, lat_count, sizeof(uint64_t), u64_cmp);
+    uint64_t first = press_us[0];
+    uint64_t last = typed_count ? typed_us[typed_count - 1] : first + 1;
+    double cps = (n > errors ? n - errors : 0) / ((last - first) / 1e6);
+    printf("%-6s %4.0f %5u %6u %8.1f %6u | %5.1f %5.1f %5.1f %5.1f\n",
+           KBSIM_NAME, report_us / 1000.0, wpm, n, cps, errors,
+           lat_count ? lat[(lat_count - 1) * 50 / 100] / 1000.0 : 0,
+           lat_count ? lat[(lat_count - 1) * 90 / 100] / 1000.0 : 0,
+           lat_count ? lat[(lat_count - 1) * 99 / 100] / 1000.0 : 0,
+           lat_count ? lat[lat_count - 1] / 1000.0 : 0);
+    if (errors && verbose)
+        printf("%.*s", (int)typed_count, typed);
+    fflush(stdout);
+    keytrace_free(&trace);
+    exit(errors ? 1 : 0);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: kbbench_" KBSIM_NAME " [options]\n"
+            "  -r <ms,...> report intervals (default 1,2,4,8)\n"
+            "  -v          print what was typed when there are errors\n"
+            "  -w <lo,hi,step> words per minute sweep (default 40,240,20)\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned intervals[8] = {1, 2, 4, 8}, interval_count = 4;
+    unsigned wpm_lo = 40, wpm_hi = 240, wpm_step = 20;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            interval_count = 0;
+            for (char *p = strtok(argv[++i], ","); p && interval_count < 8; p = strtok(NULL, ","))
+                intervals[interval_count++] = atoi(p);
+        }
+        else if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%u,%u,%u", &wpm_lo, &wpm_hi, &wpm_step) != 3)
+                usage();
+        }
+        else
+            usage();
+    }
+    if (!interval_count || !wpm_lo || !wpm_step)
+        usage();
+
+    printf("%-6s %4s %5s %6s %8s %6s | %-23s\n",
+           "scan", "rpt", "wpm", "chars", "ok c/s", "errors", "latency ms p50/p90/p99/max");
+    for (unsigned r = 0; r < interval_count; r++)
+    {
+        if (!intervals[r])
+            usage();
+        unsigned ceiling = 0;
+        bool clean = true;
+        for (unsigned wpm = wpm_lo; wpm <= wpm_hi; wpm += wpm_step)
+        {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0)
+                bench(wpm, intervals[r] * 1000);
+            int status;
+            waitpid(pid, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status))
+                clean = false;
+            else if (clean)
+                ceiling = wpm;
+        }
+        if (ceiling)
+            printf("%-6s %4u ceiling %u wpm without errors\n", KBSIM_NAME, intervals[r], ceiling);
+        else
+            printf("%-6s %4u errors at every speed\n", KBSIM_NAME, intervals[r]);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Reads a keyboard's main loop health counters over the debug
+// interface's hidraw node. Worst cases are since the last read, so
+// polling every few seconds gives the worst of each period.
+//   kbhealth /dev/hidraw3
+//   kbhealth /dev/hidraw3 5
+
+#include "health.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#endif
+
+#define REPORT_ID_HEALTH 3 // tinyusb_kb/usb_descriptors.h
+
+static void print_health(const struct health *h)
+{
+    printf("uptime %u.%03us, %u scans, %u/s\n",
+           h->uptime_ms / 1000, h->uptime_ms % 1000, h->scans, h->scan_rate);
+    printf("worst scan gap %uus (%s%uus), tud_task() %uus\n",
+           h->scan_gap_us, h->scan_gap_us > 2 * h->scan_interval_us ? "LATE, " : "",
+           h->scan_interval_us, h->tud_task_us);
+    printf("%u missed report intervals, %u phantom reports, %u ghosts held\n",
+           h->report_misses, h->phantoms, h->ghosts);
+    printf("%u frames timed late from tud_sof_cb()\n", h->sof_misses);
+}
+
+#ifdef __linux__
+static bool read_health(int fd, struct health *h)
+{
+    uint8_t buf[1 + HEALTH_REPORT_LEN];
+    buf[0] = REPORT_ID_HEALTH;
+    if (ioctl(fd, HIDIOCGFEATURE(sizeof(buf)), buf) < 0)
+    {
+        perror("HIDIOCGFEATURE");
+        return false;
+    }
+    memcpy(h, &buf[1], sizeof(*h));
+    if (h->version != HEALTH_VERSION)
+    {
+        fprintf(stderr, "keyboard has health version %u, this is %u\n",
+                h->version, HEALTH_VERSION);
+        return false;
+    }
+    return true;
+}
+#endif
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: kbhealth /dev/hidrawN [seconds]\n"
+                    "  seconds     keep reading at this interval\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3 || argv[1][0] == '-')
+        usage();
+    unsigned interval = argc > 2 ? atoi(argv[2]) : 0;
+    if (argc > 2 && !interval)
+        usage();
+#ifdef __linux__
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    do
+    {
+        struct health h;
+        if (!read_health(fd, &h))
+            return 1;
+        print_health(&h);
+        if (interval)
+        {
+            fflush(stdout);
+            sleep(interval);
+        }
+    } while (interval);
+    close(fd);
+    return 0;
+#else
+    fprintf(stderr, "hidraw is Linux only\n");
+    return 1;
+#endif
+}
@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Report timing as the host sees it. Reads keyboard reports from the
+// keyboard interface's hidraw node on Linux, timestamped on arrival,
+// or from a report stream file: one saved with -b, or kbsim -g output.
+// Prints the interval histogram, the gap from a modifier change to the
+// key it was for, and transitions that look dropped or duplicated.
+
+#include "tusb.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#endif
+
+// Same text format as host/golden, one report per line:
+//   <us> <modifier> <keycode[6]>, in hex
+#define STREAM_HEADER "# golden v1: us modifier keycode[6]\n"
+
+struct report
+{
+    uint64_t us;
+    uint8_t modifier;
+    uint8_t keycode[6];
+};
+
+static struct report *reports;
+static unsigned report_count;
+
+static void add_report(uint64_t us, const uint8_t data[7])
+{
+    reports = realloc(reports, (report_count + 1) * sizeof(*reports));
+    reports[report_count].us = us;
+    reports[report_count].modifier = data[0];
+    memcpy(reports[report_count].keycode, &data[1], 6);
+    report_count++;
+}
+
+static bool load_file(const char *name)
+{
+    FILE *f = fopen(name, "r");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    char line[256];
+    unsigned line_no = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        unsigned long long us;
+        unsigned v[7];
+        if (sscanf(line, "%llu %x %x %x %x %x %x %x", &us, &v[0], &v[1],
+                   &v[2], &v[3], &v[4], &v[5], &v[6]) != 8)
+        {
+            fprintf(stderr, "%s:%u: not a report\n", name, line_no);
+            fclose(f);
+            return false;
+        }
+        uint8_t data[7];
+        for (int i = 0; i < 7; i++)
+            data[i] = v[i];
+        add_report(us, data);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool save_file(const char *name)
+{
+    FILE *f = fopen(name, "w");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    fputs(STREAM_HEADER, f);
+    for (unsigned i = 0; i < report_count; i++)
+    {
+        fprintf(f, "%llu %02x", (unsigned long long)reports[i].us, reports[i].modifier);
+        for (int j = 0; j < 6; j++)
+            fprintf(f, " %02x", reports[i].keycode[j]);
+        fprintf(f, "\n");
+    }
+    fclose(f);
+    return true;
+}
+
+#ifdef __linux__
+// The boot keyboard report: modifier, reserved, 6 keycodes.
+static bool load_device(const char *name, unsigned ms)
+{
+    int fd = open(name, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(name);
+        return false;
+    }
+    fprintf(stderr, "reading reports for %ums\n", ms);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t start = ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+    for (;;)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now = ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+        if (now - start >= ms * 1000ull)
+            break;
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int left = ms - (now - start) / 1000;
+        if (poll(&pfd, 1, left > 0 ? left : 1) <= 0)
+            continue;
+        uint8_t buf[8];
+        if (read(fd, buf, sizeof(buf)) != sizeof(buf))
+        {
+            perror(name);
+            close(fd);
+            return false;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+        uint8_t data[7] = {buf[0]};
+        memcpy(&data[1], &buf[2], 6);
+        add_report(now - start, data);
+    }
+    close(fd);
+    return true;
+}
+#endif
+
+// Keys are named by HID usage, which is all a report carries. Which
+// Commodore key sent it depends on the geometry and the mode, so a
+// C64, C128, C16 or PET capture all read the same way.
+static const char *const modifier_names[8] = {
+    "LCTRL", "LSHIFT", "LALT", "LGUI", "RCTRL", "RSHIFT", "RALT", "RGUI"};
+
+static const char *const key_names[256] = {
+    [HID_KEY_ENTER] = "ENTER",
+    [HID_KEY_ESCAPE] = "ESCAPE",
+    [HID_KEY_BACKSPACE] = "BACKSPACE",
+    [HID_KEY_TAB] = "TAB",
+    [HID_KEY_SPACE] = "SPACE",
+    [HID_KEY_MINUS] = "MINUS",
+    [HID_KEY_EQUAL] = "EQUAL",
+    [HID_KEY_BRACKET_LEFT] = "LBRACKET",
+    [HID_KEY_BRACKET_RIGHT] = "RBRACKET",
+    [HID_KEY_BACKSLASH] = "BACKSLASH",
+    [HID_KEY_EUROPE_1] = "EUROPE_1",
+    [HID_KEY_SEMICOLON] = "SEMICOLON",
+    [HID_KEY_APOSTROPHE] = "APOSTROPHE",
+    [HID_KEY_GRAVE] = "GRAVE",
+    [HID_KEY_COMMA] = "COMMA",
+    [HID_KEY_PERIOD] = "PERIOD",
+    [HID_KEY_SLASH] = "SLASH",
+    [HID_KEY_CAPS_LOCK] = "CAPS_LOCK",
+    [HID_KEY_PRINT_SCREEN] = "PRINT_SCREEN",
+    [HID_KEY_SCROLL_LOCK] = "SCROLL_LOCK",
+    [HID_KEY_PAUSE] = "PAUSE",
+    [HID_KEY_INSERT] = "INSERT",
+    [HID_KEY_HOME] = "HOME",
+    [HID_KEY_PAGE_UP] = "PAGE_UP",
+    [HID_KEY_DELETE] = "DELETE",
+    [HID_KEY_END] = "END",
+    [HID_KEY_PAGE_DOWN] = "PAGE_DOWN",
+    [HID_KEY_ARROW_RIGHT] = "RIGHT",
+    [HID_KEY_ARROW_LEFT] = "LEFT",
+    [HID_KEY_ARROW_DOWN] = "DOWN",
+    [HID_KEY_ARROW_UP] = "UP",
+    [HID_KEY_NUM_LOCK] = "NUM_LOCK",
+    [HID_KEY_KEYPAD_DIVIDE] = "KP_SLASH",
+    [HID_KEY_KEYPAD_MULTIPLY] = "KP_ASTERISK",
+    [HID_KEY_KEYPAD_SUBTRACT] = "KP_MINUS",
+    [HID_KEY_KEYPAD_ADD] = "KP_PLUS",
+    [HID_KEY_KEYPAD_ENTER] = "KP_ENTER",
+    [HID_KEY_KEYPAD_DECIMAL] = "KP_PERIOD",
+    [HID_KEY_HELP] = "HELP",
+};
+
+static const char *key_name(uint8_t keycode)
+{
+    static char buf[16];
+    if (key_names[keycode])
+        return key_names[keycode];
+    if (keycode >= HID_KEY_A && keycode <= HID_KEY_Z)
+        snprintf(buf, sizeof(buf), "%c", 'A' + keycode - HID_KEY_A);
+    else if (keycode >= HID_KEY_1 && keycode <= HID_KEY_0)
+        snprintf(buf, sizeof(buf), "%u", (keycode - HID_KEY_1 + 1) % 10);
+    else if (keycode >= HID_KEY_F1 && keycode <= HID_KEY_F12)
+        snprintf(buf, sizeof(buf), "F%u", keycode - HID_KEY_F1 + 1);
+    else if (keycode >= HID_KEY_F13 && keycode <= HID_KEY_F24)
+        snprintf(buf, sizeof(buf), "F%u", keycode - HID_KEY_F13 + 13);
+    else if (keycode >= HID_KEY_KEYPAD_1 && keycode <= HID_KEY_KEYPAD_0)
+        snprintf(buf, sizeof(buf), "KP_%u", (keycode - HID_KEY_KEYPAD_1 + 1) % 10);
+    else
+        snprintf(buf, sizeof(buf), "hid:%02x", keycode);
+    return buf;
+}
+
+static bool has_key(const uint8_t keycode[6], uint8_t key)
+{
+    for (int i = 0; i < 6; i++)
+        if (keycode[i] == key)
+            return true;
+    return false;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_spread(const char *what, uint32_t *us, unsigned n)
+{
+    if (!n)
+    {
+        printf("%-22s none\n", what);
+        return;
+    }
+    qsort(us, n, sizeof(*us), cmp_u32);
+    printf("%-22s %6u  min %.2f  p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+           what, n, us[0] / 1000.0, us[n / 2] / 1000.0, us[n * 9 / 10] / 1000.0,
+           us[n * 99 / 100] / 1000.0, us[n - 1] / 1000.0);
+}
+
+// 250us buckets up to 20ms, wide enough for 125Hz and fine enough
+// to see 1ms polling and the SOF phase.
+#define HIST_BUCKET_US 250
+#define HIST_BUCKETS 80
+
+static void print_histogram(const uint32_t *us, unsigned n)
+{
+    unsigned hist[HIST_BUCKETS + 1] = {0};
+    unsigned most = 0;
+    for (unsigned i = 0; i < n; i++)
+    {
+        unsigned b = us[i] / HIST_BUCKET_US;
+        if (b > HIST_BUCKETS)
+            b = HIST_BUCKETS;
+        if (++hist[b] > most)
+            most = hist[b];
+    }
+    for (unsigned b = 0; b <= HIST_BUCKETS; b++)
+    {
+        if (!hist[b])
+            continue;
+        if (b == HIST_BUCKETS)
+            printf("  %5.2f+      ", b * HIST_BUCKET_US / 1000.0);
+        else
+            printf("  %5.2f-%5.2f ", b * HIST_BUCKET_US / 1000.0,
+                   (b + 1) * HIST_BUCKET_US / 1000.0);
+        printf("%7u ", hist[b]);
+        for (unsigned i = 0; i < (hist[b] * 40 + most - 1) / most; i++)
+            putchar('#');
+        putchar('\n');
+    }
+}
+
+static void analyse(bool verbose, unsigned repress_ms)
+{
+    uint32_t *intervals = malloc(report_count * sizeof(uint32_t));
+    uint32_t *mod_gaps = malloc(report_count * 6 * sizeof(uint32_t));
+    unsigned interval_count = 0, mod_gap_count = 0;
+    unsigned makes = 0, breaks = 0, unchanged = 0, coalesced = 0;
+    unsigned phantoms = 0, represses = 0;
+    uint64_t released_us[256] = {0};
+    bool released[256] = {false};
+    uint64_t modifier_us = 0;
+    bool modifier_waiting = false;
+    static const struct report none;
+    const struct report *prev = &none;
+
+    for (unsigned r = 0; r < report_count; r++)
+    {
+        const struct report *cur = &reports[r];
+        if (r)
+            intervals[interval_count++] = cur->us - reports[r - 1].us;
+        if (cur->keycode[0] == 1)
+        {
+            // Rollover error, the host keeps what it had.
+            phantoms++;
+            continue;
+        }
+        if (cur->modifier == prev->modifier && !memcmp(cur->keycode, prev->keycode, 6))
+        {
+            unchanged++;
+            continue;
+        }
+        const struct report *last = prev;
+        prev = cur;
+
+        uint8_t modifier_changed = cur->modifier ^ last->modifier;
+        for (int bit = 0; bit < 8; bit++)
+            if (modifier_changed & 1 << bit && verbose)
+                printf("%10.3f %c%s\n", cur->us / 1000.0,
+                       cur->modifier & 1 << bit ? '+' : '-', modifier_names[bit]);
+        if (modifier_changed)
+        {
+            modifier_us = cur->us;
+            modifier_waiting = true;
+        }
+
+        for (int i = 0; i < 6; i++)
+        {
+            uint8_t key = last->keycode[i];
+            if (!key || has_key(cur->keycode, key))
+                continue;
+            breaks++;
+            released[key] = true;
+            released_us[key] = cur->us;
+            if (verbose)
+                printf("%10.3f -%s\n", cur->us / 1000.0, key_name(key));
+        }
+
+        unsigned new_keys = 0;
+        for (int i = 0; i < 6; i++)
+        {
+            uint8_t key = cur->keycode[i];
+            if (!key || has_key(last->keycode, key))
+                continue;
+            makes++;
+            new_keys++;
+            bool repress = released[key] && cur->us - released_us[key] < repress_ms * 1000ull;
+            represses += repress;
+            if (modifier_waiting)
+                mod_gaps[mod_gap_count++] = cur->us - modifier_us;
+            if (verbose)
+                printf("%10.3f +%s%s\n", cur->us / 1000.0, key_name(key),
+                       repress ? "  (pressed again quickly)" : "");
+        }
+        if (new_keys)
+            modifier_waiting = false;
+        coalesced += new_keys > 1;
+    }
+
+    uint32_t median = 0;
+    unsigned late = 0;
+    if (interval_count)
+    {
+        uint32_t *sorted = malloc(interval_count * sizeof(uint32_t));
+        memcpy(sorted, intervals, interval_count * sizeof(uint32_t));
+        qsort(sorted, interval_count, sizeof(uint32_t), cmp_u32);
+        median = sorted[interval_count / 2];
+        free(sorted);
+        for (unsigned i = 0; i < interval_count; i++)
+            late += intervals[i] > median * 3 / 2;
+    }
+
+    if (verbose)
+        printf("\n");
+    printf("%u reports over %.3fs, %u unchanged\n", report_count,
+           report_count ? reports[report_count - 1].us / 1e6 : 0, unchanged);
+    printf("\ninterval histogram, ms\n");
+    print_histogram(intervals, interval_count);
+    printf("\n");
+    print_spread("report interval", intervals, interval_count);
+    print_spread("modifier to key", mod_gaps, mod_gap_count);
+    printf("\n%u makes, %u breaks\n", makes, breaks);
+    printf("%u reports made more than one key at once\n", coalesced);
+    // A device sends every interval, so a long gap is a report missed.
+    // Streams from kbsim -g only have the changes.
+    if (unchanged * 2 > report_count)
+        printf("%u intervals over 1.5x the median, dropped or late reports\n", late);
+    else
+        printf("changes only, no steady interval to find dropped reports against\n");
+    printf("%u keys pressed again within %ums of release, duplicated\n", represses, repress_ms);
+    printf("%u phantom reports\n", phantoms);
+    free(intervals);
+    free(mod_gaps);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: kblatency [options] <report stream file>\n"
+#ifdef __linux__
+            "       kblatency [options] -d /dev/hidrawN\n"
+            "  -d <dev>    read a keyboard interface\n"
+            "  -t <ms>     how long to read for (default 10000)\n"
+            "  -b <file>   also save the report stream\n"
+#endif
+            "  -r <ms>     a key back within this of release is a duplicate (default 30)\n"
+            "  -v          print every transition\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in_name = NULL, *dev_name = NULL, *save_name = NULL;
+    unsigned ms = 10000, repress_ms = 30;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            repress_ms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-v"))
+            verbose = true;
+#ifdef __linux__
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            dev_name = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+            ms = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            save_name = argv[++i];
+#endif
+        else if (argv[i][0] == '-' || in_name)
+            usage();
+        else
+            in_name = argv[i];
+    }
+    if (!in_name == !dev_name)
+        usage();
+
+#ifdef __linux__
+    if (dev_name && !load_device(dev_name, ms))
+        return 1;
+#endif
+    if (in_name && !load_file(in_name))
+        return 1;
+    if (save_name && !save_file(save_name))
+        return 1;
+    analyse(verbose, repress_ms);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Reads and tunes a keyboard's scan and report timing over the debug
+// interface's hidraw node, no reflashing needed.
+//   kbparams /dev/hidraw3
+//   kbparams /dev/hidraw3 ghost_us=1000 debounce_us=10000 save
+
+#include "paramfields.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#endif
+
+#define REPORT_ID_PARAMS 2 // tinyusb_kb/usb_descriptors.h
+
+static void print_params(const struct params *p)
+{
+    printf("version %u\n", p->version);
+    for (unsigned i = 0; i < FIELD_COUNT; i++)
+        printf("%s=%u\n", fields[i].name, get_field(p, i));
+}
+
+#ifdef __linux__
+static bool feature(int fd, bool set, uint8_t buf[1 + PARAMS_REPORT_LEN])
+{
+    buf[0] = REPORT_ID_PARAMS;
+    int len = 1 + PARAMS_REPORT_LEN;
+    if (ioctl(fd, set ? HIDIOCSFEATURE(len) : HIDIOCGFEATURE(len), buf) < 0)
+    {
+        perror(set ? "HIDIOCSFEATURE" : "HIDIOCGFEATURE");
+        return false;
+    }
+    return true;
+}
+
+static bool command(int fd, uint8_t cmd, const struct params *p)
+{
+    uint8_t buf[1 + PARAMS_REPORT_LEN] = {0};
+    buf[1] = cmd;
+    if (p)
+        memcpy(&buf[2], p, sizeof(*p));
+    return feature(fd, true, buf);
+}
+
+static bool read_params(int fd, struct params *p)
+{
+    uint8_t buf[1 + PARAMS_REPORT_LEN];
+    if (!feature(fd, false, buf))
+        return false;
+    memcpy(p, &buf[1], sizeof(*p));
+    if (p->version != PARAMS_VERSION)
+    {
+        fprintf(stderr, "keyboard has parameter version %u, this is %u\n",
+                p->version, PARAMS_VERSION);
+        return false;
+    }
+    return true;
+}
+#endif
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: kbparams /dev/hidrawN [name=value ...] [defaults] [save]\n"
+                    "  names:");
+    for (unsigned i = 0; i < FIELD_COUNT; i++)
+        fprintf(stderr, " %s", fields[i].name);
+    fprintf(stderr, "\n"
+                    "  defaults    go back to the built in values\n"
+                    "  save        keep the current values in flash\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argv[1][0] == '-')
+        usage();
+#ifdef __linux__
+    int fd = open(argv[1], O_RDWR);
+    if (fd < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    struct params p;
+    if (!read_params(fd, &p))
+        return 1;
+    bool changed = false, save = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "save"))
+        {
+            save = true;
+            continue;
+        }
+        if (!strcmp(argv[i], "defaults"))
+        {
+            if (!command(fd, PARAMS_CMD_DEFAULTS, NULL) || !read_params(fd, &p))
+                return 1;
+            continue;
+        }
+        if (!parse_field(&p, argv[i]))
+            usage();
+        changed = true;
+    }
+    if (changed)
+    {
+        struct params want = p;
+        if (!command(fd, PARAMS_CMD_SET, &want) || !read_params(fd, &p))
+            return 1;
+        if (memcmp(&want, &p, sizeof(p)))
+            fprintf(stderr, "keyboard refused the new values\n");
+    }
+    if (save && !command(fd, PARAMS_CMD_SAVE, NULL))
+        return 1;
+    print_params(&p);
+    close(fd);
+    return 0;
+#else
+    fprintf(stderr, "hidraw is Linux only\n");
+    return 1;
+#endif
+}
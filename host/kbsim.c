@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Replays a key trace through one src/kb*.c scanner and tabulates
+// latency, ghosting, dropped keys and scan cost. Built once per
+// scanner so every iteration runs unmodified, exactly as flashed.
+
+#include "sim.h"
+#include "keytrace.h"
+#include "tusb.h"
+#include "capture.h"
+#include "tracelog.h"
+#include "paramfields.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// declares for src/kb*.c
+extern hid_keyboard_modifier_bm_t kb_report(uint8_t keycode[6]);
+extern void kb_init(void);
+extern void kb_task(void);
+extern bool kb_report_pending(void);
+extern void kb_sync(absolute_time_t scan_at);
+
+// Scanners without a report sequencer only report from hid_task().
+__attribute__((weak)) bool kb_report_pending(void)
+{
+    return false;
+}
+
+// Scanners that can't be phased to the USB frame free-run.
+__attribute__((weak)) void kb_sync(absolute_time_t scan_at)
+{
+    (void)scan_at;
+}
+
+#ifndef KBSIM_NAME
+#define KBSIM_NAME "kb"
+#endif
+
+#define STALE_US 50000 // a release this old can no longer be matched
+
+static uint32_t loop_us = 2;       // main loop time spent outside kb_task()
+static uint32_t report_us = 8000;  // hid_task() interval
+static uint32_t settle_us = 20000; // idle time before the first key
+static uint32_t poll_us = 1000;    // host poll interval, bInterval
+static const char *capture_name;   // -c file for capture2vcd
+static FILE *tracelog_file;         // -t file for tracelog2txt
+static FILE *golden_file;           // -g file, the report stream
+static bool frames;                // latency is to the frame a report goes out in
+static bool sof_sync;              // phase scans and reports as sof_task() does
+
+#define SOF_LEAD_US 100 // tinyusb_kb/main.c
+
+struct press
+{
+    uint64_t down_us;
+    uint64_t up_us; // 0 while held
+    uint8_t key;
+    bool reported;
+    bool ghosted; // held while the matrix showed a ghost
+};
+
+static struct press *presses;
+static unsigned press_count;
+static int by_hid[256]; // which press a reported keycode belongs to, or -1
+
+struct samples
+{
+    uint32_t *us;
+    unsigned count;
+};
+
+static struct samples press_lat, release_lat;
+static unsigned ghost_fp, ghost_fn, dropped, extra, early, phantom;
+static uint64_t scan_ns, scan_busy_us, report_ns;
+static unsigned scans, reports;
+
+static void sample(struct samples *s, uint64_t us)
+{
+    s->us = realloc(s->us, (s->count + 1) * sizeof(*s->us));
+    s->us[s->count++] = (uint32_t)us;
+}
+
+static int u32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct(struct samples *s, unsigned p)
+{
+    if (!s->count)
+        return 0;
+    return s->us[(s->count - 1) * p / 100] / 1000.0;
+}
+
+static uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// Modifiers are sent as bits, not keycodes, so they aren't tracked.
+static bool tracked(uint key)
+{
+    return key != 2 && key != 5 && key != 11 && key != 52;
+}
+
+static void apply(const struct keytrace_event *ev)
+{
+    sim_key(ev->key, ev->down, ev->bounce_us);
+    if (tracked(ev->key))
+    {
+        if (ev->down)
+        {
+            presses = realloc(presses, (press_count + 1) * sizeof(*presses));
+            presses[press_count++] = (struct press){
+                .down_us = ev->us,
+                .key = ev->key,
+            };
+        }
+        else
+            for (unsigned i = press_count; i-- > 0;)
+                if (presses[i].key == ev->key && !presses[i].up_us)
+                {
+                    presses[i].up_us = ev->us;
+                    break;
+                }
+    }
+    // Anything not yet reported while a ghost is showing is at risk.
+    if (sim_any_ghost())
+        for (unsigned i = 0; i < press_count; i++)
+            if (!presses[i].reported && !presses[i].up_us)
+                presses[i].ghosted = true;
+}
+
+static void report_press(uint8_t hid, uint64_t now)
+{
+    for (unsigned i = 0; i < press_count; i++)
+    {
+        struct press *p = &presses[i];
+        if (p->reported || (p->up_us && now - p->up_us > STALE_US))
+            continue;
+        p->reported = true;
+        by_hid[hid] = i;
+        sample(&press_lat, now - p->down_us);
+        return;
+    }
+    if (sim_any_ghost())
+        ghost_fp++;
+    else
+        extra++;
+}
+
+static void report_release(uint8_t hid, uint64_t now)
+{
+    int i = by_hid[hid];
+    by_hid[hid] = -1;
+    if (i >= 0 && presses[i].up_us)
+        sample(&release_lat, now - presses[i].up_us);
+    else
+        early++; // released while still held
+}
+
+static void report(const uint8_t cur[6], uint64_t now)
+{
+    static uint8_t prev[6];
+    if (cur[0] == 1)
+    {
+        phantom++;
+        return;
+    }
+    for (int i = 0; i < 6; i++)
+        if (cur[i] > 1 && cur[i] < HID_KEY_CONTROL_LEFT && !memchr(prev, cur[i], 6))
+            report_press(cur[i], now);
+    for (int i = 0; i < 6; i++)
+        if (prev[i] > 1 && prev[i] < HID_KEY_CONTROL_LEFT && !memchr(cur, prev[i], 6))
+            report_release(prev[i], now);
+    memcpy(prev, cur, 6);
+}
+
+// Every report that differs from the one before, for host/golden.
+#define GOLDEN_VERSION 1
+static void golden_report(uint8_t modifier, const uint8_t keycode[6], uint64_t now)
+{
+    static uint8_t prev[7];
+    static bool started;
+    uint8_t cur[7] = {modifier};
+    memcpy(&cur[1], keycode, 6);
+    if (!started)
+        fprintf(golden_file, "# golden v%d: us modifier keycode[6]\n", GOLDEN_VERSION);
+    else if (!memcmp(cur, prev, 7))
+        return;
+    started = true;
+    memcpy(prev, cur, 7);
+    fprintf(golden_file, "%llu", (unsigned long long)now);
+    for (int i = 0; i < 7; i++)
+        fprintf(golden_file, " %02x", cur[i]);
+    fprintf(golden_file, "\n");
+}
+
+static void run(const struct keytrace *trace)
+{
+    uint64_t end_us = settle_us + 500000;
+    if (trace->count)
+        end_us += trace->events[trace->count - 1].us;
+    uint64_t next_report = 0;
+    uint64_t next_sequence = 0; // tud_hid_report_complete_cb() report, 0 if none
+    uint64_t next_sof = 0;
+    uint64_t scan_at = 0; // phased scan this frame, 0 if none
+    unsigned next_event = 0;
+
+    memset(by_hid, -1, sizeof(by_hid));
+    if (capture_name)
+        capture_start();
+    kb_init();
+    while (sim_now() < end_us)
+    {
+        while (next_event < trace->count &&
+               trace->events[next_event].us + settle_us <= sim_now())
+        {
+            struct keytrace_event ev = trace->events[next_event++];
+            ev.us += settle_us;
+            apply(&ev);
+        }
+
+        // SOFs are at multiples of the poll interval.
+        uint64_t entered = sim_now();
+        bool new_frame = sof_sync && entered >= next_sof;
+        if (new_frame)
+        {
+            next_sof = (entered / poll_us + 1) * poll_us;
+            scan_at = next_sof - SOF_LEAD_US;
+            kb_sync(scan_at);
+        }
+
+        uint32_t reads = sim_reads;
+        uint64_t busy = sim_busy_us;
+        uint64_t t0 = host_ns();
+        kb_task();
+        uint64_t t1 = host_ns();
+        if (sim_reads != reads)
+        {
+            scans++;
+            scan_ns += t1 - t0;
+            scan_busy_us += sim_busy_us - busy;
+        }
+
+        bool due = !sof_sync;
+        if (sof_sync && !new_frame && scan_at && entered >= scan_at)
+        {
+            scan_at = 0;
+            due = true;
+        }
+        bool timed = due && sim_now() >= next_report;
+        if (timed || (next_sequence && sim_now() >= next_sequence))
+        {
+            if (timed)
+                next_report = sim_now() + report_us - (sof_sync ? poll_us / 2 : 0);
+            uint8_t keycode[6] = {0};
+            t0 = host_ns();
+            uint8_t modifier = kb_report(keycode);
+            report_ns += host_ns() - t0;
+            reports++;
+            // as keyboard_report() in tinyusb_kb/main.c
+            capture(CAPTURE_REPORT, 0, modifier | keycode[0] << 8);
+            capture(CAPTURE_REPORT, 1, keycode[1] | keycode[2] << 8);
+            capture(CAPTURE_REPORT, 2, keycode[3] | keycode[4] << 8);
+            capture(CAPTURE_REPORT, 3, keycode[5]);
+            TRACELOG(TRACELOG_REPORT, modifier, keycode[0], keycode[1],
+                     keycode[2], keycode[3], keycode[4], keycode[5]);
+            // The IN token follows the next SOF.
+            uint64_t sent = frames ? (sim_now() / poll_us + 1) * poll_us : sim_now();
+            report(keycode, sent);
+            if (golden_file)
+                golden_report(modifier, keycode, sent);
+            next_sequence = 0;
+            if (kb_report_pending())
+                next_sequence = frames ? sent : sim_now() + poll_us;
+        }
+
+        // as tracelog_task() in tinyusb_kb/main.c
+        const uint8_t *data;
+        uint len;
+        while ((len = tracelog_peek(&data)))
+        {
+            if (tracelog_file)
+                fwrite(data, 1, len, tracelog_file);
+            tracelog_consume(len);
+        }
+
+        sim_advance(loop_us);
+    }
+
+    for (unsigned i = 0; i < press_count; i++)
+        if (!presses[i].reported)
+        {
+            if (presses[i].ghosted)
+                ghost_fn++;
+            else
+                dropped++;
+        }
+}
+
+static bool save_capture(const char *name)
+{
+    FILE *f = fopen(name, "wb");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    uint count;
+    const struct capture_event *events = capture_events(&count);
+    fwrite(CAPTURE_MAGIC, 1, 8, f);
+    fwrite(events, sizeof(*events), count, f);
+    fclose(f);
+    if (count == CAPTURE_EVENTS)
+        fprintf(stderr, "%s: capture buffer filled\n", name);
+    return true;
+}
+
+static void print_header(void)
+{
+    printf("%-6s %-22s %6s | %-27s | %-27s | %5s %5s %5s %5s %5s %5s | %8s %8s %9s\n",
+           "scan", "trace", "keys",
+           "press ms p50/p90/p99/max", "release ms p50/p90/p99/max",
+           "gh+", "gh-", "drop", "extra", "early", "phant",
+           "scan ns", "scan us", "report ns");
+}
+
+static void print_row(const char *trace_name)
+{
+    qsort(press_lat.us, press_lat.count, sizeof(uint32_t), u32_cmp);
+    qsort(release_lat.us, release_lat.count, sizeof(uint32_t), u32_cmp);
+    const char *base = strrchr(trace_name, '/');
+    char press_col[32], release_col[32];
+    snprintf(press_col, sizeof(press_col), "%.1f/%.1f/%.1f/%.1f",
+             pct(&press_lat, 50), pct(&press_lat, 90),
+             pct(&press_lat, 99), pct(&press_lat, 100));
+    snprintf(release_col, sizeof(release_col), "%.1f/%.1f/%.1f/%.1f",
+             pct(&release_lat, 50), pct(&release_lat, 90),
+             pct(&release_lat, 99), pct(&release_lat, 100));
+    printf("%-6s %-22s %6u | %-27s | %-27s | %5u %5u %5u %5u %5u %5u | %8.0f %8.1f %9.0f\n",
+           KBSIM_NAME, base ? base + 1 : trace_name, press_count,
+           press_col, release_col,
+           ghost_fp, ghost_fn, dropped, extra, early, phantom,
+           scans ? (double)scan_ns / scans : 0,
+           scans ? (double)scan_busy_us / scans : 0,
+           reports ? (double)report_ns / reports : 0);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: kbsim_" KBSIM_NAME " [options] <trace | synth:typing | synth:ghost>\n"
+            "  -H          print the table header and exit\n"
+            "  -l <us>     main loop overhead per iteration (default 2)\n"
+            "  -p <us>     host poll interval for sequenced reports (default 1000)\n"
+            "  -c <file>   save an event capture for capture2vcd\n"
+            "  -t <file>   save the trace log for tracelog2txt\n"
+            "  -g <file>   save the report stream, as in host/golden\n"
+            "  -f          latency is to the USB frame a report goes out in\n"
+            "  -r <ms>     report interval (default 8)\n"
+            "  -P <n=v>    set a tunable in kb_params, e.g. ghost=1, see kbparams\n"
+            "  -s <ms>     idle time after power on before the trace (default 20)\n"
+            "  -S          phase scans and reports to USB frames, implies -f\n"
+            "              use -s 0 to hold keys at time 0 through power on\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *trace_name = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-H"))
+        {
+            print_header();
+            return 0;
+        }
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+            loop_us = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-f"))
+            frames = true;
+        else if (!strcmp(argv[i], "-S"))
+            frames = sof_sync = true;
+        else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+            capture_name = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            if (!(tracelog_file = fopen(argv[++i], "wb")))
+            {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-g") && i + 1 < argc)
+        {
+            if (!(golden_file = fopen(argv[++i], "w")))
+            {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-p") && i + 1 < argc)
+            poll_us = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-P") && i + 1 < argc)
+        {
+            struct params p = kb_params;
+            if (!parse_field(&p, argv[++i]) || !params_apply(&p))
+            {
+                fprintf(stderr, "bad or refused parameter %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            report_us = atoi(argv[++i]) * 1000;
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            settle_us = atoi(argv[++i]) * 1000;
+        else if (argv[i][0] == '-' || trace_name)
+            usage();
+        else
+            trace_name = argv[i];
+    }
+    if (!trace_name || !loop_us || !report_us || !poll_us)
+        usage();
+
+    struct keytrace trace;
+    if (!keytrace_load(&trace, trace_name))
+        return 1;
+    sim_reset();
+    run(&trace);
+    print_row(trace_name);
+    if (capture_name && !save_capture(capture_name))
+        return 1;
+    if (tracelog_file)
+        fclose(tracelog_file);
+    if (golden_file)
+        fclose(golden_file);
+    keytrace_free(&trace);
+    return 0;
+}
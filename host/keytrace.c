@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "keytrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+const char *const cbm_key_names[65] = {
+    "1", "LEFT_ARROW", "CTRL", "RUN_STOP", "SPACE", "CBM", "Q", "2",   // 0-7
+    "3", "W", "A", "LSHIFT", "Z", "S", "E", "4",                        // 8-15
+    "5", "R", "D", "X", "C", "F", "T", "6",                             // 16-23
+    "7", "Y", "G", "V", "B", "H", "U", "8",                             // 24-31
+    "9", "I", "J", "N", "M", "K", "O", "0",                             // 32-39
+    "PLUS", "P", "L", "COMMA", "PERIOD", "COLON", "AT", "MINUS",        // 40-47
+    "POUND", "ASTERISK", "SEMICOLON", "SLASH", "RSHIFT", "EQUAL",       // 48-53
+    "UP_ARROW", "HOME", "DEL", "RETURN", "CRSR_RIGHT", "CRSR_DOWN",     // 54-59
+    "F1", "F3", "F5", "F7", "RESTORE"                                   // 60-64
+};
+
+int cbm_key_lookup(const char *name)
+{
+    for (int i = 0; i < 65; i++)
+        if (!strcasecmp(name, cbm_key_names[i]))
+            return i;
+    return -1;
+}
+
+void keytrace_add(struct keytrace *trace, uint64_t us, uint8_t key, bool down, uint32_t bounce_us)
+{
+    if (trace->count == trace->capacity)
+    {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 256;
+        trace->events = realloc(trace->events, trace->capacity * sizeof(*trace->events));
+    }
+    trace->events[trace->count++] = (struct keytrace_event){us, key, down, bounce_us};
+}
+
+// Insertion sort is stable and traces are nearly in order already.
+void keytrace_sort(struct keytrace *trace)
+{
+    for (unsigned i = 1; i < trace->count; i++)
+    {
+        struct keytrace_event ev = trace->events[i];
+        unsigned j = i;
+        for (; j > 0 && trace->events[j - 1].us > ev.us; j--)
+            trace->events[j] = trace->events[j - 1];
+        trace->events[j] = ev;
+    }
+}
+
+void keytrace_free(struct keytrace *trace)
+{
+    free(trace->events);
+    memset(trace, 0, sizeof(*trace));
+}
+
+// Deterministic so every scanner sees the same synthetic corpus.
+static uint32_t rnd_state;
+static uint32_t rnd(uint32_t n)
+{
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return (rnd_state >> 8) % n;
+}
+
+// Letters and space at about 80 WPM, with overlap and bounce.
+static void synth_typing(struct keytrace *trace)
+{
+    static const uint8_t keys[] = {
+        10, 28, 20, 18, 14, 21, 26, 29, 33, 34, 37, 42, 36, 35, 38,
+        41, 6, 17, 13, 22, 30, 27, 9, 19, 25, 12, 4, 4, 4};
+    uint64_t t = 10000;
+    for (int i = 0; i < 2000; i++)
+    {
+        uint8_t key = keys[rnd(sizeof(keys))];
+        uint32_t hold = 60000 + rnd(60000);
+        keytrace_add(trace, t, key, true, rnd(1500));
+        keytrace_add(trace, t + hold, key, false, rnd(1500));
+        // Fast typists press the next key before releasing this one.
+        t += 90000 + rnd(80000) - (rnd(3) ? 0 : hold / 2);
+        if (t < trace->events[trace->count - 2].us + 25000)
+            t = trace->events[trace->count - 2].us + 25000;
+    }
+}
+
+// Three corners of a matrix rectangle held together, as games do.
+static void synth_ghost(struct keytrace *trace)
+{
+    uint64_t t = 10000;
+    for (int i = 0; i < 300; i++)
+    {
+        uint r0 = rnd(8), r1 = (r0 + 1 + rnd(7)) % 8;
+        uint c0 = rnd(8), c1 = (c0 + 1 + rnd(7)) % 8;
+        uint8_t corner[3] = {r0 * 8 + c0, r0 * 8 + c1, r1 * 8 + c0};
+        for (int k = 0; k < 3; k++)
+            keytrace_add(trace, t + k * (5000 + rnd(30000)), corner[k], true, rnd(1000));
+        t += 200000;
+        for (int k = 0; k < 3; k++)
+            keytrace_add(trace, t + rnd(40000), corner[k], false, rnd(1000));
+        t += 150000;
+    }
+}
+
+static bool synth(struct keytrace *trace, const char *kind)
+{
+    rnd_state = 0x64;
+    if (!strcmp(kind, "typing"))
+        synth_typing(trace);
+    else if (!strcmp(kind, "ghost"))
+        synth_ghost(trace);
+    else
+    {
+        fprintf(stderr, "unknown synthetic trace: %s\n", kind);
+        return false;
+    }
+    keytrace_sort(trace);
+    return true;
+}
+
+bool keytrace_load(struct keytrace *trace, const char *name)
+{
+    memset(trace, 0, sizeof(*trace));
+    if (!strncmp(name, "synth:", 6))
+        return synth(trace, name + 6);
+
+    FILE *f = fopen(name, "r");
+    if (!f)
+    {
+        perror(name);
+        return false;
+    }
+    char line[256];
+    unsigned lineno = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash)
+            *hash = 0;
+        double ms;
+        char key[32];
+        unsigned bounce = 0;
+        int n = sscanf(line, "%lf %31s %u", &ms, key, &bounce);
+        if (n <= 0)
+            continue;
+        int code = n >= 2 && (key[0] == '+' || key[0] == '-') ? cbm_key_lookup(key + 1) : -1;
+        if (code < 0)
+        {
+            fprintf(stderr, "%s:%u: bad event\n", name, lineno);
+            fclose(f);
+            keytrace_free(trace);
+            return false;
+        }
+        keytrace_add(trace, (uint64_t)(ms * 1000), code, key[0] == '+', bounce);
+    }
+    fclose(f);
+    keytrace_sort(trace);
+    return true;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_KEYTRACE_H
+#define _HOST_KEYTRACE_H
+
+// Physical key traces replayed into the simulated matrix.
+//
+// Text format, one event per line, # starts a comment:
+//   <time_ms> +<key> [bounce_us]    press
+//   <time_ms> -<key> [bounce_us]    release
+// Keys are names from cbm_key_names, case insensitive.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct keytrace_event
+{
+    uint64_t us;
+    uint8_t key;
+    bool down;
+    uint32_t bounce_us;
+};
+
+struct keytrace
+{
+    struct keytrace_event *events;
+    unsigned count;
+    unsigned capacity;
+};
+
+extern const char *const cbm_key_names[65];
+int cbm_key_lookup(const char *name);
+
+// Load from a file, or generate when name is "synth:<kind>".
+// Returns false and prints why on failure.
+bool keytrace_load(struct keytrace *trace, const char *name);
+void keytrace_add(struct keytrace *trace, uint64_t us, uint8_t key, bool down, uint32_t bounce_us);
+void keytrace_sort(struct keytrace *trace);
+void keytrace_free(struct keytrace *trace);
+
+#endif
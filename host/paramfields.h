@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_PARAMFIELDS_H
+#define _HOST_PARAMFIELDS_H
+
+// Names for the fields of struct params, so host tools can take
+// name=value arguments. Shared by kbparams and kbsim -P.
+
+#include "params.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct
+{
+    const char *name;
+    size_t offset;
+    size_t size;
+} fields[] = {
+#define FIELD(name) {#name, offsetof(struct params, name), sizeof(((struct params *)0)->name)}
+    FIELD(cas_us),
+    FIELD(scan_interval_us),
+    FIELD(ghost_us),
+    FIELD(debounce_us),
+    FIELD(wake_expire_ms),
+    FIELD(report_ms),
+    FIELD(mister),
+    FIELD(acquire),
+    FIELD(debounce),
+    FIELD(ghost),
+    FIELD(report),
+};
+#define FIELD_COUNT (sizeof(fields) / sizeof(fields[0]))
+
+static inline uint32_t get_field(const struct params *p, unsigned i)
+{
+    uint32_t value = 0;
+    memcpy(&value, (const uint8_t *)p + fields[i].offset, fields[i].size);
+    return value;
+}
+
+static inline void set_field(struct params *p, unsigned i, uint32_t value)
+{
+    memcpy((uint8_t *)p + fields[i].offset, &value, fields[i].size);
+}
+
+// Sets a field from "name=value", false for an unknown name.
+static inline bool parse_field(struct params *p, const char *arg)
+{
+    const char *eq = strchr(arg, '=');
+    unsigned f = 0;
+    while (eq && f < FIELD_COUNT &&
+           (strlen(fields[f].name) != (size_t)(eq - arg) ||
+            strncmp(fields[f].name, arg, eq - arg)))
+        f++;
+    if (!eq || f == FIELD_COUNT)
+        return false;
+    set_field(p, f, strtoul(eq + 1, NULL, 0));
+    return true;
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "sim.h"
+#include "hardware/structs/systick.h"
+#include <string.h>
+#include <time.h>
+
+#define SIM_PINS 30
+#define SIM_GND SIM_PINS // extra node for switches to ground
+
+uint64_t sim_busy_us;
+uint32_t sim_reads;
+
+static uint64_t now_us;
+
+static struct
+{
+    bool out;
+    bool value;
+    bool pull_up;
+} pins[SIM_PINS];
+
+static struct
+{
+    bool down;
+    uint64_t changed_us;
+    uint32_t bounce_us;
+} keys[SIM_KEYS];
+
+// Wiring from README.md: rows GP0-7, columns GP8-15, RESTORE GP18.
+static void key_pins(uint key, uint *a, uint *b)
+{
+    if (key < 64)
+    {
+        *a = key / 8;
+        *b = 8 + key % 8;
+    }
+    else
+    {
+        *a = 18;
+        *b = SIM_GND;
+    }
+}
+
+// Contacts chatter pseudo-randomly in 40us slices while bouncing.
+static bool key_closed(uint key, bool settled)
+{
+    if (!settled && now_us < keys[key].changed_us + keys[key].bounce_us)
+    {
+        uint32_t h = (uint32_t)(now_us / 40) * 2654435761u ^ key * 40503u;
+        return (h >> 13) & 1;
+    }
+    return keys[key].down;
+}
+
+static uint find(uint8_t *parent, uint n)
+{
+    while (parent[n] != n)
+        n = parent[n] = parent[parent[n]];
+    return n;
+}
+
+// Union-find over pins, skipping one key if requested.
+static void connect(uint8_t parent[SIM_PINS + 1], bool settled, int skip)
+{
+    for (uint i = 0; i <= SIM_PINS; i++)
+        parent[i] = i;
+    for (uint key = 0; key < SIM_KEYS; key++)
+    {
+        if ((int)key == skip || !key_closed(key, settled))
+            continue;
+        uint a, b;
+        key_pins(key, &a, &b);
+        parent[find(parent, a)] = find(parent, b);
+    }
+}
+
+void sim_reset(void)
+{
+    memset(pins, 0, sizeof(pins));
+    memset(keys, 0, sizeof(keys));
+    now_us = 0;
+    sim_busy_us = 0;
+    sim_reads = 0;
+}
+
+uint64_t sim_now(void)
+{
+    return now_us;
+}
+
+void sim_advance(uint32_t us)
+{
+    now_us += us;
+}
+
+void sim_key(uint key, bool down, uint32_t bounce_us)
+{
+    keys[key].down = down;
+    keys[key].changed_us = now_us;
+    keys[key].bounce_us = bounce_us;
+}
+
+bool sim_key_down(uint key)
+{
+    return keys[key].down;
+}
+
+bool sim_key_visible(uint key)
+{
+    uint8_t parent[SIM_PINS + 1];
+    uint a, b;
+    connect(parent, true, -1);
+    key_pins(key, &a, &b);
+    return find(parent, a) == find(parent, b);
+}
+
+bool sim_any_ghost(void)
+{
+    uint8_t parent[SIM_PINS + 1];
+    connect(parent, true, -1);
+    for (uint key = 0; key < 64; key++)
+    {
+        uint a, b;
+        key_pins(key, &a, &b);
+        if (!keys[key].down && find(parent, a) == find(parent, b))
+            return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// Pico SDK stand-ins
+//--------------------------------------------------------------------+
+
+void gpio_init(uint gpio)
+{
+    pins[gpio].out = false;
+    pins[gpio].value = false;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    pins[gpio].out = out;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    pins[gpio].value = value;
+}
+
+void gpio_pull_up(uint gpio)
+{
+    pins[gpio].pull_up = true;
+}
+
+void gpio_disable_pulls(uint gpio)
+{
+    pins[gpio].pull_up = false;
+}
+
+uint32_t gpio_get_all(void)
+{
+    uint8_t parent[SIM_PINS + 1];
+    bool low[SIM_PINS + 1] = {false};
+    connect(parent, false, -1);
+    low[find(parent, SIM_GND)] = true;
+    for (uint i = 0; i < SIM_PINS; i++)
+        if (pins[i].out && !pins[i].value)
+            low[find(parent, i)] = true;
+    uint32_t all = 0;
+    for (uint i = 0; i < SIM_PINS; i++)
+    {
+        bool value = pins[i].out ? pins[i].value : !low[find(parent, i)];
+        if (value)
+            all |= 1u << i;
+    }
+    sim_reads++;
+    return all;
+}
+
+bool gpio_get(uint gpio)
+{
+    return (gpio_get_all() >> gpio) & 1;
+}
+
+// No interrupts on the host. Suspend isn't simulated.
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+    (void)gpio;
+    (void)event_mask;
+    (void)enabled;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+    (void)callback;
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t event_mask)
+{
+    (void)gpio;
+    (void)event_mask;
+}
+
+void busy_wait_us_32(uint32_t delay_us)
+{
+    now_us += delay_us;
+    sim_busy_us += delay_us;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    return now_us;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)now_us;
+}
+
+uint64_t time_us_64(void)
+{
+    return now_us;
+}
+
+systick_hw_t *sim_systick(void)
+{
+    static systick_hw_t systick;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t host_ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    systick.cvr = (0xFFFFFF - (now_us * 125 + host_ns / 8)) & 0xFFFFFF;
+    return &systick;
+}
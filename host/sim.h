@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HOST_SIM_H
+#define _HOST_SIM_H
+
+// Simulated C64 keyboard wired to the Pi Pico as in README.md.
+// The matrix has no diodes, so any path of closed switches
+// between a strobed column and a row pulls that row low.
+
+#include "pico/stdlib.h"
+
+#define SIM_KEYS 65 // 64 in matrix + RESTORE
+
+void sim_reset(void);
+uint64_t sim_now(void);
+void sim_advance(uint32_t us);
+
+// Physical key change at the current time.
+// Contacts chatter for bounce_us before settling.
+void sim_key(uint key, bool down, uint32_t bounce_us);
+bool sim_key_down(uint key);
+
+// Matrix analysis of the settled (non-bouncing) switch states.
+bool sim_key_visible(uint key); // reads as pressed through the matrix
+bool sim_any_ghost(void);       // some visible key is not pressed
+
+// Counters for cost measurements
+extern uint64_t sim_busy_us;
+extern uint32_t sim_reads;
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Decodes the binary trace log from the keyboard's GP16 UART, or
+// from a file saved with kbsim -t or this tool's -b. Decoding can
+// start anywhere in the stream, it waits for the next event.
+
+#include "tracelog.h"
+#include "keytrace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <termios.h>
+#endif
+
+#define TRACELOG_FORMAT(id, args, format) [id] = {args, format},
+static const struct
+{
+    uint args;
+    const char *format;
+} tracelog_formats[] = {TRACELOG_EVENTS(TRACELOG_FORMAT)};
+#define TRACELOG_IDS (sizeof(tracelog_formats) / sizeof(tracelog_formats[0]))
+
+static void print_event(FILE *out, uint64_t us, uint8_t id, const uint32_t *args)
+{
+    fprintf(out, "%4llu.%06llu ", (unsigned long long)(us / 1000000),
+            (unsigned long long)(us % 1000000));
+    if (id >= TRACELOG_IDS)
+    {
+        fprintf(out, "unknown event %u\n", id);
+        return;
+    }
+    const char *f = tracelog_formats[id].format;
+    for (; *f; f++)
+    {
+        if (*f != '%' || !f[1])
+        {
+            fputc(*f, out);
+            continue;
+        }
+        uint32_t arg = *args++;
+        switch (*++f)
+        {
+        case 'x':
+            fprintf(out, "%02x", arg);
+            break;
+        case 'k':
+            if (arg < sizeof(cbm_key_names) / sizeof(cbm_key_names[0]))
+                fputs(cbm_key_names[arg], out);
+            else
+                fprintf(out, "%u", arg);
+            break;
+        default:
+            fprintf(out, "%u", arg);
+            break;
+        }
+    }
+    fputc('\n', out);
+}
+
+// Byte at a time, so it works the same on a live stream.
+static struct
+{
+    bool in_event;
+    uint8_t id;
+    uint argc;  // including the time delta
+    uint shift; // of the varint being read
+    uint32_t values[1 + TRACELOG_ARGS_MAX];
+    uint64_t us;
+    unsigned events;
+    unsigned skipped;
+} dec;
+
+static void decode(FILE *out, uint8_t byte)
+{
+    if (byte & 0x80)
+    {
+        if (dec.in_event)
+            dec.skipped++;
+        dec.in_event = true;
+        dec.id = byte & 0x7F;
+        dec.argc = 0;
+        dec.shift = 0;
+        dec.values[0] = 0;
+        return;
+    }
+    if (!dec.in_event)
+    {
+        dec.skipped++;
+        return;
+    }
+    dec.values[dec.argc] |= (uint32_t)(byte & 0x3F) << dec.shift;
+    dec.shift += 6;
+    if (byte & 0x40)
+        return;
+    dec.shift = 0;
+    uint args = dec.id < TRACELOG_IDS ? tracelog_formats[dec.id].args : 0;
+    if (++dec.argc <= args && dec.argc <= TRACELOG_ARGS_MAX)
+    {
+        dec.values[dec.argc] = 0;
+        return;
+    }
+    dec.in_event = false;
+    dec.us += dec.values[0];
+    dec.events++;
+    print_event(out, dec.us, dec.id, &dec.values[1]);
+}
+
+#ifdef __linux__
+static int open_serial(const char *name)
+{
+    int fd = open(name, O_RDONLY | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(name);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);
+    cfsetospeed(&tio, B115200);
+    tcsetattr(fd, TCSANOW, &tio);
+    return fd;
+}
+#endif
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: tracelog2txt [options] <trace log file>\n"
+#ifdef __linux__
+            "       tracelog2txt [options] -d /dev/ttyUSB0\n"
+            "  -d <dev>    read live from the keyboard's UART, until ^C\n"
+            "  -b <file>   also save the raw log\n"
+#endif
+            "  -o <file>   text output (default stdout)\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *in_name = NULL, *dev_name = NULL, *out_name = NULL, *bin_name = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out_name = argv[++i];
+#ifdef __linux__
+        else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            dev_name = argv[++i];
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            bin_name = argv[++i];
+#endif
+        else if (argv[i][0] == '-' || in_name)
+            usage();
+        else
+            in_name = argv[i];
+    }
+    if (!in_name == !dev_name)
+        usage();
+
+    FILE *in = NULL, *out = stdout, *bin = NULL;
+#ifdef __linux__
+    if (dev_name)
+    {
+        int fd = open_serial(dev_name);
+        if (fd < 0 || !(in = fdopen(fd, "rb")))
+            return 1;
+    }
+#endif
+    if (in_name && !(in = fopen(in_name, "rb")))
+    {
+        perror(in_name);
+        return 1;
+    }
+    if (out_name && !(out = fopen(out_name, "w")))
+    {
+        perror(out_name);
+        return 1;
+    }
+    if (bin_name && !(bin = fopen(bin_name, "wb")))
+    {
+        perror(bin_name);
+        return 1;
+    }
+
+    int c;
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (bin)
+            fputc(c, bin);
+        decode(out, c);
+        if (dev_name)
+            fflush(out);
+    }
+
+    fclose(in);
+    if (bin)
+        fclose(bin);
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%u events, %u bytes skipped\n", dec.events, dec.skipped);
+    return 0;
+}
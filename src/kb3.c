@@ -46,9 +46,6 @@ static const uint8_t CBM_TO_HID[] = {
 
 void kb_init()
 {
-    // Using GP16-17 for stdio
-    stdio_uart_init_full(uart0, 115200, 16, 17);
-
     // RESTORE key not part of matrix
     // pin 1 to ground, pin 3 to GP18
     gpio_set_dir(18, GPIO_IN);
@@ -201,9 +201,6 @@ static void set_cbm_scan(uint idx, bool is_up)
 
 void kb_init()
 {
-    // Using GP16-17 for stdio
-    stdio_uart_init_full(uart0, 115200, 16, 17);
-
     // RESTORE key not part of matrix
     // pin 1 to ground, pin 3 to GP18
     gpio_set_dir(18, GPIO_IN);
@@ -120,7 +120,6 @@ static void cbm_translate_ascii(uint8_t *code, hid_keyboard_modifier_bm_t *modif
         case CBM_KEY_DEL:
             *modifier = KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTALT;
             *code = HID_KEY_DELETE;
-            printf("%d %d\n", *code, *modifier);
             return;
         }
     const hid_keyboard_modifier_bm_t SHIFT =
@@ -328,9 +327,6 @@ static void set_cbm_scan(uint idx, bool is_up)
 
 void kb_init()
 {
-    // Using GP16-17 for stdio
-    stdio_uart_init_full(uart0, 115200, 16, 17);
-
     // RESTORE key not part of matrix
     // pin 1 to ground, pin 3 to GP18
     gpio_set_dir(18, GPIO_IN);
@@ -5,98 +5,227 @@
  */
 
 #include "pico/stdlib.h"
+#include "hardware/structs/systick.h"
 #include "tusb.h"
+#include "capture.h"
+#include "tracelog.h"
+#include "params.h"
+#include "health.h"
 
 // Debounce and ghost detection added.
 // Keycode mappings for ASCII, VICE, and MiSTer.
 // Includes edge case for CRSR keys.
 
-#define KB_CAS_US 6
-#define KB_SCAN_INTERVAL_US 200
-#define KB_GHOST_US 2000     // safety wait for bouncing ghost keys
-#define KB_DEBOUNCE_US 20000 // keys are sticky for this long
-static_assert(KB_DEBOUNCE_US > KB_GHOST_US);
+// Timing is tunable at run time, see tinyusb_kb/params.h.
+#define KB_CAS_US (kb_params.cas_us)
+#define KB_SCAN_INTERVAL_US (kb_params.scan_interval_us)
+#define KB_GHOST_US (kb_params.ghost_us)
+#define KB_DEBOUNCE_US (kb_params.debounce_us)
 
-#define KB_GHOST_TICKS ((KB_GHOST_US + KB_SCAN_INTERVAL_US - 1) / KB_SCAN_INTERVAL_US)
-#define KB_DEBOUNCE_TICKS ((KB_DEBOUNCE_US + KB_SCAN_INTERVAL_US - 1) / KB_SCAN_INTERVAL_US)
+// Recomputed when the parameters change.
+static uint kb_ghost_ticks;
+static uint kb_debounce_ticks;
+#define KB_GHOST_TICKS kb_ghost_ticks
+#define KB_DEBOUNCE_TICKS kb_debounce_ticks
+
+// Keyboard geometry and keycode tables for each board.
+#if defined(CBM_PET)
+#include "kb_pet.h"
+#elif defined(CBM_C16)
+#include "kb_c16.h"
+#elif defined(CBM_C128)
+#include "kb_c128.h"
+#else
+#include "kb_c64.h"
+#endif
 
 // Until MiSTer allows for custom remapping, we do a toggle.
 // MiSTer global keyboard remapping will not do what we need.
-static bool is_mister = false; // can be true if you prefer
+static bool is_mister; // starts as kb_params.mister
 
 static struct cbm_scan
 {
     uint status;   // 0=open, 1=pressed, 2+=ghost
     uint debounce; // countdown to 0
     bool sent;
+    bool ghost; // held back by the last scan's pop count
+    hid_keyboard_modifier_bm_t modifier;
+    uint32_t since; // scan it went down on
+} cbm_scan[KB_KEYS];
+
+// The matrix keys that still have work to do, a bit per row for each
+// column. A key that agrees with the matrix and has no timer running
+// is skipped, so an idle scan is a compare per column.
+#define KB_ROW_MASK ((1u << KB_ROWS) - 1)
+static uint16_t kb_down[KB_COLS];     // status != 0
+static uint16_t kb_waiting[KB_COLS];  // status > 1
+static uint16_t kb_bouncing[KB_COLS]; // debounce != 0
+
+// Set when a key may have joined the queue for kb_report().
+static bool kb_queued;
+
+// Cleared when a matrix key is confirmed or released.
+static bool kb_modifier_valid;
+
+// Counts scans, for ordering presses.
+static uint32_t kb_scans;
+
+// Keys held at power on have long stopped bouncing, so the first
+// scan doesn't wait for them to settle or wait out the ghost timer.
+static bool kb_primed;
+
+// The scan is a pipeline of stages, each with a table of strategies
+// picked by kb_params, so they can be compared on one keyboard.
+// Cycles spent in each are counted and logged once a second.
+enum
+{
+    KB_STAGE_ACQUIRE,   // read the matrix
+    KB_STAGE_DEBOUNCE,  // raw changes to key presses
+    KB_STAGE_GHOST,     // confirm presses that can't be ghosts
+    KB_STAGE_TRANSLATE, // CBM key to HID keycode, per key
+    KB_STAGE_REPORT,    // assemble a report, including translation
+    KB_STAGES
+};
+
+static struct
+{
+    uint32_t calls;
+    uint32_t cycles;
+    uint32_t max;
+} kb_stages[KB_STAGES];
+
+// SysTick counts down from 2^24 at the system clock.
+static inline uint32_t kb_cycles()
+{
+    return systick_hw->cvr;
+}
+
+// Strobe to sample spacing. On time it's KB_CAS_US, anything more is
+// jitter, like an XIP cache miss in the wait. Compare kb6 and kb6_ram.
+static struct
+{
+    uint32_t count;
+    uint32_t cycles;
+    uint32_t min;
+    uint32_t max;
+} kb_strobes = {.min = UINT32_MAX};
+
+static void kb_strobe_done(uint32_t start)
+{
+    uint32_t cycles = (start - systick_hw->cvr) & 0xFFFFFF;
+    kb_strobes.count++;
+    kb_strobes.cycles += cycles;
+    if (cycles < kb_strobes.min)
+        kb_strobes.min = cycles;
+    if (cycles > kb_strobes.max)
+        kb_strobes.max = cycles;
+}
+
+static void kb_stage_done(uint stage, uint32_t start)
+{
+    uint32_t cycles = (start - systick_hw->cvr) & 0xFFFFFF;
+    kb_stages[stage].calls++;
+    kb_stages[stage].cycles += cycles;
+    if (cycles > kb_stages[stage].max)
+        kb_stages[stage].max = cycles;
+}
+
+// C= can be a function layer key instead of TAB or ALT.
+static bool is_cbm_layer = false; // can be true if you prefer
+
+// Layers remap keys while a chord of modifiers or a layer key is held.
+// Each layer is a table indexed by CBM code, so resolving a key is one
+// lookup however many chords there are. Codes of keys a keyboard
+// doesn't have are past KB_KEYS, hence the full 256 entries.
+enum
+{
+    KB_LAYER_BASE, // no overrides
+    KB_LAYER_SYSTEM,
+    KB_LAYER_CBM,
+    KB_LAYERS
+};
+
+#define KB_ACT_KEEP_MODIFIER 0x01 // send with the modifiers held
+#define KB_ACT_TOGGLE_MISTER 0x02 // swap between ASCII and MiSTer mode
+
+// A zero keycode is no override, the key translates normally.
+struct kb_action
+{
+    uint8_t keycode;
     hid_keyboard_modifier_bm_t modifier;
-} cbm_scan[65];
-
-// Default keycode translations are the positional mapping used by MiSTer.
-// These keycodes are unique to how the Pi Pico is wired and scanned.
-static const uint8_t CBM_TO_HID[] = {
-    HID_KEY_1, HID_KEY_GRAVE, HID_KEY_CONTROL_LEFT, HID_KEY_ESCAPE,              // 0-3
-    HID_KEY_SPACE, HID_KEY_ALT_LEFT, HID_KEY_Q, HID_KEY_2,                       // 4-7
-    HID_KEY_3, HID_KEY_W, HID_KEY_A, HID_KEY_SHIFT_LEFT,                         // 8-11
-    HID_KEY_Z, HID_KEY_S, HID_KEY_E, HID_KEY_4,                                  // 12-15
-    HID_KEY_5, HID_KEY_R, HID_KEY_D, HID_KEY_X,                                  // 16-19
-    HID_KEY_C, HID_KEY_F, HID_KEY_T, HID_KEY_6,                                  // 20-23
-    HID_KEY_7, HID_KEY_Y, HID_KEY_G, HID_KEY_V,                                  // 24-27
-    HID_KEY_B, HID_KEY_H, HID_KEY_U, HID_KEY_8,                                  // 28-31
-    HID_KEY_9, HID_KEY_I, HID_KEY_J, HID_KEY_N,                                  // 32-35
-    HID_KEY_M, HID_KEY_K, HID_KEY_O, HID_KEY_0,                                  // 36-39
-    HID_KEY_EQUAL, HID_KEY_P, HID_KEY_L, HID_KEY_COMMA,                          // 40-43
-    HID_KEY_PERIOD, HID_KEY_SEMICOLON, HID_KEY_BRACKET_LEFT, HID_KEY_MINUS,      // 44-47
-    HID_KEY_BACKSLASH, HID_KEY_BRACKET_RIGHT, HID_KEY_APOSTROPHE, HID_KEY_SLASH, // 48-51
-    HID_KEY_SHIFT_RIGHT, HID_KEY_END, HID_KEY_PAGE_DOWN, HID_KEY_HOME,           // 52-55
-    HID_KEY_DELETE, HID_KEY_ENTER, HID_KEY_ARROW_RIGHT, HID_KEY_ARROW_DOWN,      // 56-59
-    HID_KEY_F1, HID_KEY_F3, HID_KEY_F5, HID_KEY_F7,                              // 60-63
-    HID_KEY_F11                                                                  // 64
+    uint8_t flags;
 };
-// All the keys except letters
-#define CBM_KEY_1 0
-#define CBM_KEY_2 7
-#define CBM_KEY_3 8
-#define CBM_KEY_4 15
-#define CBM_KEY_5 16
-#define CBM_KEY_6 23
-#define CBM_KEY_7 24
-#define CBM_KEY_8 31
-#define CBM_KEY_9 32
-#define CBM_KEY_0 39
-#define CBM_KEY_ARROW_LEFT 1
-#define CBM_KEY_CONTROL_LEFT 2
-#define CBM_KEY_RUN_STOP 3
-#define CBM_KEY_SPACE 4
-#define CBM_KEY_CBM 5 // C= key
-#define CBM_KEY_SHIFT_LEFT 11
-#define CBM_KEY_PLUS 40
-#define CBM_KEY_COMMA 43
-#define CBM_KEY_PERIOD 44
-#define CBM_KEY_COLON 45
-#define CBM_KEY_COMMERCIAL_AT 46
-#define CBM_KEY_MINUS 47
-#define CBM_KEY_STERLING 48
-#define CBM_KEY_ASTERISK 49
-#define CBM_KEY_SEMICOLON 50
-#define CBM_KEY_SLASH 51
-#define CBM_KEY_SHIFT_RIGHT 52
-#define CBM_KEY_EQUAL 53
-#define CBM_KEY_ARROW_UP 54
-#define CBM_KEY_HOME 55
-#define CBM_KEY_DEL 56
-#define CBM_KEY_RETURN 57
-#define CBM_KEY_CRSR_RIGHT 58
-#define CBM_KEY_CRSR_DOWN 59
-#define CBM_KEY_F1 60
-#define CBM_KEY_F3 61
-#define CBM_KEY_F5 62
-#define CBM_KEY_F7 63
-#define CBM_KEY_RESTORE 64
+
+// Modifier chords that select a layer
+static const uint8_t KB_CHORD_LAYER[256] = {
+    [KEYBOARD_MODIFIER_LEFTCTRL |
+        KEYBOARD_MODIFIER_LEFTSHIFT |
+        KEYBOARD_MODIFIER_RIGHTSHIFT] = KB_LAYER_SYSTEM,
+};
+
+// C= layer, the same in both modes
+#define KB_CBM_LAYER_ACTIONS                                             \
+    [CBM_KEY_1] = {HID_KEY_F1, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_2] = {HID_KEY_F2, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_3] = {HID_KEY_F3, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_4] = {HID_KEY_F4, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_5] = {HID_KEY_F5, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_6] = {HID_KEY_F6, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_7] = {HID_KEY_F7, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_8] = {HID_KEY_F8, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_9] = {HID_KEY_F9, 0, KB_ACT_KEEP_MODIFIER},                \
+    [CBM_KEY_0] = {HID_KEY_F10, 0, KB_ACT_KEEP_MODIFIER},               \
+    [CBM_KEY_PLUS] = {HID_KEY_F11, 0, KB_ACT_KEEP_MODIFIER},            \
+    [CBM_KEY_MINUS] = {HID_KEY_F12, 0, KB_ACT_KEEP_MODIFIER},           \
+    [CBM_KEY_HOME] = {HID_KEY_PAGE_UP, 0, KB_ACT_KEEP_MODIFIER},        \
+    [CBM_KEY_CRSR_DOWN] = {HID_KEY_PAGE_DOWN, 0, KB_ACT_KEEP_MODIFIER}, \
+    [CBM_KEY_CRSR_RIGHT] = {HID_KEY_END, 0, KB_ACT_KEEP_MODIFIER},      \
+    [CBM_KEY_DEL] = {HID_KEY_DELETE, 0, KB_ACT_KEEP_MODIFIER}
+
+// These overrides makes the C64 keyboard suitable for ASCII.
+static const struct kb_action KB_ASCII_LAYERS[KB_LAYERS][256] = {
+    [KB_LAYER_SYSTEM] = {
+        [CBM_KEY_STERLING] = {HID_KEY_SHIFT_RIGHT, 0, KB_ACT_KEEP_MODIFIER | KB_ACT_TOGGLE_MISTER},
+        [CBM_KEY_DEL] = {HID_KEY_DELETE, KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTALT, 0},
+        [CBM_KEY_F1] = {HID_KEY_F9, 0, 0},
+        [CBM_KEY_F3] = {HID_KEY_F10, 0, 0},
+        [CBM_KEY_F5] = {HID_KEY_F11, 0, 0},
+        [CBM_KEY_F7] = {HID_KEY_F12, 0, 0},
+    },
+    [KB_LAYER_CBM] = {KB_CBM_LAYER_ACTIONS},
+};
+
+static const struct kb_action KB_MISTER_LAYERS[KB_LAYERS][256] = {
+    [KB_LAYER_SYSTEM] = {
+        [CBM_KEY_STERLING] = {HID_KEY_SHIFT_RIGHT, 0, KB_ACT_KEEP_MODIFIER | KB_ACT_TOGGLE_MISTER},
+        [CBM_KEY_DEL] = {HID_KEY_ALT_RIGHT, KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTALT | KEYBOARD_MODIFIER_RIGHTALT, 0},
+    },
+    [KB_LAYER_CBM] = {KB_CBM_LAYER_ACTIONS},
+};
+
+// Applies a layer override if there is one. The layer comes from
+// a held layer key, otherwise from the modifier chord.
+static bool cbm_translate_layer(const struct kb_action layers[KB_LAYERS][256], uint layer,
+                                uint8_t *code, hid_keyboard_modifier_bm_t *modifier)
+{
+    if (layer == KB_LAYER_BASE)
+        layer = KB_CHORD_LAYER[*modifier];
+    const struct kb_action *action = &layers[layer][*code];
+    if (!action->keycode)
+        return false;
+    *code = action->keycode;
+    if (!(action->flags & KB_ACT_KEEP_MODIFIER))
+        *modifier = action->modifier;
+    if (action->flags & KB_ACT_TOGGLE_MISTER)
+        is_mister = !is_mister;
+    return true;
+}
 
 // Translate CBM code into USB HID keyboard modifier bitmap
 static hid_keyboard_modifier_bm_t cbm_to_modifier(uint8_t cbmcode)
 {
+    if (is_cbm_layer && cbmcode == CBM_KEY_CBM)
+        return 0;
     uint8_t keycode = CBM_TO_HID[cbmcode];
     if (!is_mister && keycode == HID_KEY_ALT_LEFT)
         return 0;
@@ -105,41 +234,10 @@ static hid_keyboard_modifier_bm_t cbm_to_modifier(uint8_t cbmcode)
     return 0;
 }
 
-// These overrides makes the C64 keyboard suitable for ASCII.
 static void cbm_translate_ascii(uint8_t *code, hid_keyboard_modifier_bm_t *modifier)
 {
     uint8_t cbmcode = *code;
     *code = CBM_TO_HID[cbmcode];
-    if (*modifier == (KEYBOARD_MODIFIER_LEFTCTRL |
-                      KEYBOARD_MODIFIER_LEFTSHIFT |
-                      KEYBOARD_MODIFIER_RIGHTSHIFT))
-        switch (cbmcode)
-        {
-        case CBM_KEY_STERLING:
-            *code = HID_KEY_SHIFT_RIGHT;
-            is_mister = true;
-            return;
-        case CBM_KEY_DEL:
-            *modifier = KEYBOARD_MODIFIER_LEFTCTRL | KEYBOARD_MODIFIER_LEFTALT;
-            *code = HID_KEY_DELETE;
-            return;
-        case CBM_KEY_F1:
-            *code = HID_KEY_F9;
-            *modifier = 0;
-            break;
-        case CBM_KEY_F3:
-            *code = HID_KEY_F10;
-            *modifier = 0;
-            break;
-        case CBM_KEY_F5:
-            *code = HID_KEY_F11;
-            *modifier = 0;
-            break;
-        case CBM_KEY_F7:
-            *code = HID_KEY_F12;
-            *modifier = 0;
-            break;
-        }
     const hid_keyboard_modifier_bm_t SHIFT =
         KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT;
     if (*modifier & SHIFT)
@@ -255,6 +353,10 @@ static void cbm_translate_ascii(uint8_t *code, hid_keyboard_modifier_bm_t *modif
         case CBM_KEY_DEL:
             *code = HID_KEY_BACKSPACE;
             break;
+        default:
+            if (KB_FORCE_SHIFT(cbmcode))
+                *modifier |= KEYBOARD_MODIFIER_LEFTSHIFT;
+            break;
         }
     // Overrides for both SHIFT states.
     switch (cbmcode)
@@ -279,22 +381,6 @@ static void cbm_translate_mister(uint8_t *code, hid_keyboard_modifier_bm_t *modi
 {
     uint8_t cbmcode = *code;
     *code = CBM_TO_HID[cbmcode];
-    if (*modifier == (KEYBOARD_MODIFIER_LEFTCTRL |
-                      KEYBOARD_MODIFIER_LEFTSHIFT |
-                      KEYBOARD_MODIFIER_RIGHTSHIFT))
-        switch (cbmcode)
-        {
-        case CBM_KEY_STERLING:
-            *code = HID_KEY_SHIFT_RIGHT;
-            is_mister = false;
-            return;
-        case CBM_KEY_DEL:
-            *modifier = KEYBOARD_MODIFIER_LEFTCTRL |
-                        KEYBOARD_MODIFIER_LEFTALT |
-                        KEYBOARD_MODIFIER_RIGHTALT;
-            *code = HID_KEY_ALT_RIGHT;
-            return;
-        }
     const hid_keyboard_modifier_bm_t SHIFT =
         KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT;
     if (*modifier & SHIFT)
@@ -327,6 +413,26 @@ static void cbm_translate_mister(uint8_t *code, hid_keyboard_modifier_bm_t *modi
         }
 }
 
+// Translation strategies, picked by the mode.
+static const struct kb_translator
+{
+    const struct kb_action (*layers)[256];
+    void (*translate)(uint8_t *code, hid_keyboard_modifier_bm_t *modifier);
+} KB_TRANSLATORS[] = {
+    {KB_ASCII_LAYERS, cbm_translate_ascii},
+    {KB_MISTER_LAYERS, cbm_translate_mister},
+};
+
+static void cbm_release(uint idx)
+{
+    if (cbm_scan[idx].status == 1)
+        TRACELOG(TRACELOG_KEY_UP, idx);
+    cbm_scan[idx].status = 0;
+    cbm_scan[idx].sent = false;
+    cbm_scan[idx].ghost = false;
+}
+
+// Acts on the first edge, then ignores the key until it settles.
 static void set_cbm_scan(uint idx, bool is_up)
 {
     if (cbm_scan[idx].debounce)
@@ -335,8 +441,7 @@ static void set_cbm_scan(uint idx, bool is_up)
     {
         if (cbm_scan[idx].status)
         {
-            cbm_scan[idx].status = 0;
-            cbm_scan[idx].sent = false;
+            cbm_release(idx);
             cbm_scan[idx].debounce = KB_DEBOUNCE_TICKS;
         }
     }
@@ -350,97 +455,540 @@ static void set_cbm_scan(uint idx, bool is_up)
     }
 }
 
+// Acts once the contacts have agreed for the whole debounce time,
+// so a single glitch is never a keystroke, at the cost of latency.
+// Keys held at power on have long since agreed, so the first scan
+// takes them as they are, like the lockout debouncer does.
+static void set_cbm_scan_steady(uint idx, bool is_up)
+{
+    if (is_up == !cbm_scan[idx].status)
+        cbm_scan[idx].debounce = 0;
+    else if (!kb_primed && !is_up)
+        cbm_scan[idx].status = 1 + KB_GHOST_TICKS;
+    else if (!cbm_scan[idx].debounce)
+        cbm_scan[idx].debounce = KB_DEBOUNCE_TICKS;
+    else if (!--cbm_scan[idx].debounce)
+    {
+        if (is_up)
+            cbm_release(idx);
+        else
+            cbm_scan[idx].status = 1 + KB_GHOST_TICKS;
+    }
+}
+
+static void (*const KB_DEBOUNCERS[PARAMS_DEBOUNCES])(uint idx, bool is_up) = {
+    [PARAMS_DEBOUNCE_LOCKOUT] = set_cbm_scan,
+    [PARAMS_DEBOUNCE_STEADY] = set_cbm_scan_steady,
+};
+
+#ifdef KB_LATCHES
+// Switches that latch down. Every change of position
+// is sent as a tap so the host's lock follows the switch.
+static void set_cbm_latch(uint latch, bool is_up)
+{
+    static bool latched[KB_LATCHES];
+    uint idx = CBM_KEY_LATCH(latch);
+    if (cbm_scan[idx].status == 1 && cbm_scan[idx].sent)
+        cbm_scan[idx].status = 0;
+    if (cbm_scan[idx].debounce)
+        --cbm_scan[idx].debounce;
+    else if (latched[latch] == is_up)
+    {
+        latched[latch] = !is_up;
+        cbm_scan[idx].status = 1;
+        cbm_scan[idx].sent = false;
+        cbm_scan[idx].debounce = KB_DEBOUNCE_TICKS;
+        kb_queued = true;
+    }
+}
+#endif
+
+// Bring the work bits of a matrix key up to date with its state.
+static void kb_mark(uint row, uint col)
+{
+    uint idx = row * KB_COLS + col;
+    uint16_t bit = 1u << row;
+    bool was_held = (kb_down[col] & ~kb_waiting[col]) & bit;
+    if (was_held != (cbm_scan[idx].status == 1))
+    {
+        kb_modifier_valid = false;
+        kb_queued |= !was_held;
+    }
+    if (!(kb_down[col] & bit))
+        cbm_scan[idx].since = kb_scans;
+    kb_down[col] &= ~bit;
+    kb_waiting[col] &= ~bit;
+    kb_bouncing[col] &= ~bit;
+    if (cbm_scan[idx].status)
+        kb_down[col] |= bit;
+    if (cbm_scan[idx].status > 1)
+        kb_waiting[col] |= bit;
+    if (cbm_scan[idx].debounce)
+        kb_bouncing[col] |= bit;
+}
+
+// Modifiers of the matrix keys held down, recomputed
+// only after a key changes or the mode is toggled.
+static hid_keyboard_modifier_bm_t kb_modifier()
+{
+    static hid_keyboard_modifier_bm_t modifier;
+    static bool mister;
+    if (kb_modifier_valid && mister == is_mister)
+        return modifier;
+    kb_modifier_valid = true;
+    mister = is_mister;
+    modifier = 0;
+    for (uint col = 0; col < KB_COLS; col++)
+        for (uint held = kb_down[col] & ~kb_waiting[col]; held; held &= held - 1)
+            modifier |= cbm_to_modifier(__builtin_ctz(held) * KB_COLS + col);
+    return modifier;
+}
+
+// The mode only follows kb_params.mister when that changes, so setting
+// other parameters doesn't undo a switch made with the chord.
+static void kb_params_update()
+{
+    static uint32_t generation;
+    static bool valid = false;
+    static bool mister;
+    if (valid && generation == params_generation)
+        return;
+    if (!valid || mister != kb_params.mister)
+        is_mister = mister = kb_params.mister;
+    valid = true;
+    generation = params_generation;
+    kb_ghost_ticks = (KB_GHOST_US + KB_SCAN_INTERVAL_US - 1) / KB_SCAN_INTERVAL_US;
+    kb_debounce_ticks = (KB_DEBOUNCE_US + KB_SCAN_INTERVAL_US - 1) / KB_SCAN_INTERVAL_US;
+}
+
 void kb_init()
 {
-    // Using GP16-17 for stdio
-    stdio_uart_init_full(uart0, 115200, 16, 17);
+    kb_params_update();
+
+    // SysTick free runs as the cycle counter for kb_stages
+    systick_hw->rvr = 0xFFFFFF;
+    systick_hw->csr = 0x5; // enabled, system clock
+
+#ifdef KB_RESTORE_PIN
+    gpio_set_dir(KB_RESTORE_PIN, GPIO_IN);
+    gpio_pull_up(KB_RESTORE_PIN);
+    gpio_init(KB_RESTORE_PIN);
+#endif
+
+    for (uint row = 0; row < KB_ROWS; row++)
+    {
+        gpio_set_dir(KB_ROW_PIN(row), GPIO_IN);
+        gpio_pull_up(KB_ROW_PIN(row));
+        gpio_init(KB_ROW_PIN(row));
+    }
+
+    for (uint col = 0; col < KB_COLS; col++)
+    {
+        gpio_set_dir(KB_COL_PIN(col), GPIO_IN);
+        gpio_put(KB_COL_PIN(col), false);
+        gpio_disable_pulls(KB_COL_PIN(col));
+        gpio_init(KB_COL_PIN(col));
+    }
+
+#ifdef KB_LATCHES
+    for (uint latch = 0; latch < KB_LATCHES; latch++)
+    {
+        gpio_set_dir(KB_LATCH_PIN(latch), GPIO_IN);
+        gpio_pull_up(KB_LATCH_PIN(latch));
+        gpio_init(KB_LATCH_PIN(latch));
+    }
+#endif
+}
+
+// Low power USB suspend. All columns are driven so any key,
+// or RESTORE, pulls a line low and the falling edge calls wake.
+bool kb_suspend(gpio_irq_callback_t wake)
+{
+    for (uint col = 0; col < KB_COLS; col++)
+        gpio_set_dir(KB_COL_PIN(col), GPIO_OUT);
+    busy_wait_us_32(KB_CAS_US);
+    for (uint row = 0; row < KB_ROWS; row++)
+    {
+        gpio_acknowledge_irq(KB_ROW_PIN(row), GPIO_IRQ_EDGE_FALL);
+        gpio_set_irq_enabled_with_callback(KB_ROW_PIN(row), GPIO_IRQ_EDGE_FALL, true, wake);
+    }
+#ifdef KB_RESTORE_PIN
+    gpio_acknowledge_irq(KB_RESTORE_PIN, GPIO_IRQ_EDGE_FALL);
+    gpio_set_irq_enabled(KB_RESTORE_PIN, GPIO_IRQ_EDGE_FALL, true);
+#endif
+    return true;
+}
+
+void kb_resume()
+{
+    for (uint row = 0; row < KB_ROWS; row++)
+        gpio_set_irq_enabled(KB_ROW_PIN(row), GPIO_IRQ_EDGE_FALL, false);
+#ifdef KB_RESTORE_PIN
+    gpio_set_irq_enabled(KB_RESTORE_PIN, GPIO_IRQ_EDGE_FALL, false);
+#endif
+    for (uint col = 0; col < KB_COLS; col++)
+        gpio_set_dir(KB_COL_PIN(col), GPIO_IN);
+}
 
-    // RESTORE key not part of matrix
-    // pin 1 to ground, pin 3 to GP18
-    gpio_set_dir(18, GPIO_IN);
-    gpio_pull_up(18);
-    gpio_init(18);
+// Debounced and ghost state changes for the capture buffer.
+static void kb_capture_keys(bool snapshot)
+{
+    static bool down[KB_KEYS];
+    static bool ghost[KB_KEYS];
+    for (uint idx = 0; idx < KB_KEYS; idx++)
+    {
+        bool is_down = cbm_scan[idx].status == 1;
+        if (snapshot || is_down != down[idx])
+        {
+            down[idx] = is_down;
+            capture(CAPTURE_KEY, idx, is_down);
+        }
+        if (snapshot || cbm_scan[idx].ghost != ghost[idx])
+        {
+            ghost[idx] = cbm_scan[idx].ghost;
+            capture(CAPTURE_GHOST, idx, ghost[idx]);
+        }
+    }
+}
 
-    // "row data" pins 20-13 on GP0-7
-    for (uint i = 0; i < 8; i++)
+// Acquisition strategies fill in the keys pressed, a bit per row
+// for each column, and capture the raw rows.
+static uint16_t kb_raw[KB_COLS];
+
+static void kb_acquire_strobe(uint16_t pressed[KB_COLS], bool snapshot)
+{
+    for (uint col = 0; col < KB_COLS; col++)
     {
-        gpio_set_dir(i, GPIO_IN);
-        gpio_pull_up(i);
-        gpio_init(i);
+        gpio_set_dir(KB_COL_PIN(col), GPIO_OUT);
+        uint32_t strobe = kb_cycles();
+        busy_wait_us_32(KB_CAS_US);
+        uint row_data = KB_ROW_DATA(gpio_get_all());
+        kb_strobe_done(strobe);
+        gpio_set_dir(KB_COL_PIN(col), GPIO_IN);
+        if (snapshot || row_data != kb_raw[col])
+        {
+            kb_raw[col] = row_data;
+            capture(CAPTURE_ROWS, col, row_data);
+        }
+        pressed[col] = ~row_data & KB_ROW_MASK;
     }
+}
 
-    // "column" pins 12-5 on GP8-15
-    for (uint i = 8; i < 16; i++)
+// Drive every column at once first. With no row pulled low nothing
+// at all is pressed, which is most scans, and one settle time does.
+// Otherwise it takes the usual strobes to find out which keys, so
+// while any key is down or settling they're used straight away.
+// The all-columns settle isn't a strobe, so kb_strobes leaves it out.
+static void kb_acquire_probe(uint16_t pressed[KB_COLS], bool snapshot)
+{
+    uint16_t busy = 0;
+    for (uint col = 0; col < KB_COLS; col++)
+        busy |= kb_down[col] | kb_waiting[col] | kb_bouncing[col];
+    if (busy)
+    {
+        kb_acquire_strobe(pressed, snapshot);
+        return;
+    }
+    for (uint col = 0; col < KB_COLS; col++)
+        gpio_set_dir(KB_COL_PIN(col), GPIO_OUT);
+    busy_wait_us_32(KB_CAS_US);
+    uint row_data = KB_ROW_DATA(gpio_get_all());
+    for (uint col = 0; col < KB_COLS; col++)
+        gpio_set_dir(KB_COL_PIN(col), GPIO_IN);
+    if (~row_data & KB_ROW_MASK)
+    {
+        kb_acquire_strobe(pressed, snapshot);
+        return;
+    }
+    for (uint col = 0; col < KB_COLS; col++)
     {
-        gpio_set_dir(i, GPIO_IN);
-        gpio_put(i, false);
-        gpio_disable_pulls(i);
-        gpio_init(i);
+        if (snapshot || kb_raw[col] != KB_ROW_MASK)
+        {
+            kb_raw[col] = KB_ROW_MASK;
+            capture(CAPTURE_ROWS, col, KB_ROW_MASK);
+        }
+        pressed[col] = 0;
+    }
+}
+
+static void (*const KB_ACQUIRERS[PARAMS_ACQUIRES])(uint16_t pressed[KB_COLS], bool snapshot) = {
+    [PARAMS_ACQUIRE_STROBE] = kb_acquire_strobe,
+    [PARAMS_ACQUIRE_PROBE] = kb_acquire_probe,
+};
+
+// A waiting key with nothing to make it a ghost counts down, and
+// a suspect one starts over, until it can be trusted.
+static void kb_ghost_wait(uint row, uint col, bool ghost, hid_keyboard_modifier_bm_t modifier)
+{
+    uint idx = row * KB_COLS + col;
+    kb_health.ghosts += ghost && !cbm_scan[idx].ghost;
+    cbm_scan[idx].ghost = ghost;
+    if (ghost)
+        cbm_scan[idx].status = 1 + KB_GHOST_TICKS;
+    else if (!kb_primed)
+    {
+        cbm_scan[idx].status = 1;
+        TRACELOG(TRACELOG_KEY_DOWN, idx);
+    }
+    else if (--cbm_scan[idx].status == 1)
+    {
+        cbm_scan[idx].modifier = modifier;
+        TRACELOG(TRACELOG_KEY_DOWN, idx);
+    }
+    kb_mark(row, col);
+}
+
+// A key can only be a ghost of keys that were down before it, or
+// within a ghost wait after, as contacts bounce. Without diodes it
+// shows when its row and column are joined by a path through those
+// keys. Keys pressed later can't have made it appear, so they don't
+// restart its wait, and a key isn't held just for sharing a row and
+// column with keys that aren't linked.
+static bool kb_ghost_path(uint row, uint col, uint32_t since)
+{
+    uint16_t partners[KB_COLS];
+    for (uint c = 0; c < KB_COLS; c++)
+    {
+        partners[c] = 0;
+        for (uint down = kb_down[c]; down; down &= down - 1)
+        {
+            uint r = __builtin_ctz(down);
+            if ((int32_t)(cbm_scan[r * KB_COLS + c].since - since) <= (int32_t)KB_GHOST_TICKS &&
+                (r != row || c != col))
+                partners[c] |= 1u << r;
+        }
+    }
+    // Flood out from the key's column, a row and column set at a time.
+    uint32_t cols = 1u << col, seen = 0;
+    uint rows = 0;
+    while (cols != seen)
+    {
+        uint32_t fresh = cols & ~seen;
+        seen = cols;
+        for (; fresh; fresh &= fresh - 1)
+            rows |= partners[__builtin_ctz(fresh)];
+        for (uint c = 0; c < KB_COLS; c++)
+            if (partners[c] & rows)
+                cols |= 1u << c;
+    }
+    return rows & (1u << row);
+}
+
+// Use pop count to find ghosted keys. A key with others on both its
+// row and column closes a square, and without diodes every corner of
+// it conducts the same in both directions. Scanning rows instead of
+// columns, or walking longer paths, reads back this same picture.
+// Counts include ghosted and bouncing keys.
+static void kb_ghost_hold(hid_keyboard_modifier_bm_t modifier)
+{
+    uint8_t kb_col_pop[KB_COLS];
+    uint8_t kb_row_pop[KB_ROWS] = {0};
+    for (uint col = 0; col < KB_COLS; col++)
+    {
+        kb_col_pop[col] = __builtin_popcount(kb_down[col]);
+        for (uint down = kb_down[col]; down; down &= down - 1)
+            ++kb_row_pop[__builtin_ctz(down)];
+    }
+    for (uint col = 0; col < KB_COLS; col++)
+    {
+        for (uint wait = kb_waiting[col]; wait; wait &= wait - 1)
+        {
+            uint row = __builtin_ctz(wait);
+            kb_ghost_wait(row, col, kb_col_pop[col] > 1 && kb_row_pop[row] > 1, modifier);
+        }
+    }
+}
+
+static void kb_ghost_temporal(hid_keyboard_modifier_bm_t modifier)
+{
+    for (uint col = 0; col < KB_COLS; col++)
+    {
+        for (uint wait = kb_waiting[col]; wait; wait &= wait - 1)
+        {
+            uint row = __builtin_ctz(wait);
+            uint idx = row * KB_COLS + col;
+            kb_ghost_wait(row, col, kb_ghost_path(row, col, cbm_scan[idx].since), modifier);
+        }
     }
 }
 
+// Every key the matrix shows is pressed, ghosts included.
+static void kb_ghost_none(hid_keyboard_modifier_bm_t modifier)
+{
+    for (uint col = 0; col < KB_COLS; col++)
+    {
+        for (uint wait = kb_waiting[col]; wait; wait &= wait - 1)
+        {
+            uint row = __builtin_ctz(wait);
+            uint idx = row * KB_COLS + col;
+            cbm_scan[idx].status = 1;
+            cbm_scan[idx].modifier = modifier;
+            TRACELOG(TRACELOG_KEY_DOWN, idx);
+            kb_mark(row, col);
+        }
+    }
+}
+
+static void (*const KB_GHOST_RESOLVERS[PARAMS_GHOSTS])(hid_keyboard_modifier_bm_t modifier) = {
+    [PARAMS_GHOST_HOLD] = kb_ghost_hold,
+    [PARAMS_GHOST_NONE] = kb_ghost_none,
+    [PARAMS_GHOST_TEMPORAL] = kb_ghost_temporal,
+};
+
+// Once a second, with the strategy each stage used.
+static void kb_stage_log(absolute_time_t now)
+{
+    static absolute_time_t next_log_us;
+    if (absolute_time_diff_us(now, next_log_us) > 0)
+        return;
+    next_log_us = delayed_by_us(now, 1000000);
+    const uint strategy[KB_STAGES] = {
+        [KB_STAGE_ACQUIRE] = kb_params.acquire,
+        [KB_STAGE_DEBOUNCE] = kb_params.debounce,
+        [KB_STAGE_GHOST] = kb_params.ghost,
+        [KB_STAGE_TRANSLATE] = is_mister,
+        [KB_STAGE_REPORT] = kb_params.report,
+    };
+    for (uint stage = 0; stage < KB_STAGES; stage++)
+    {
+        if (kb_stages[stage].calls)
+            TRACELOG(TRACELOG_STAGE, stage, strategy[stage], kb_stages[stage].calls,
+                     kb_stages[stage].cycles / kb_stages[stage].calls, kb_stages[stage].max);
+        kb_stages[stage].calls = kb_stages[stage].cycles = kb_stages[stage].max = 0;
+    }
+    if (kb_strobes.count)
+        TRACELOG(TRACELOG_STROBE, kb_strobes.count, kb_strobes.min,
+                 kb_strobes.cycles / kb_strobes.count, kb_strobes.max);
+    kb_strobes.count = kb_strobes.cycles = kb_strobes.max = 0;
+    kb_strobes.min = UINT32_MAX;
+}
+
+static absolute_time_t next_scan_us = {0};
+
+// Phase scanning to the USB frame. The scan interval is unchanged,
+// just shifted so one of the scans starts exactly at scan_at.
+void kb_sync(absolute_time_t scan_at)
+{
+    absolute_time_t now = get_absolute_time();
+    int64_t ahead = absolute_time_diff_us(now, scan_at);
+    if (ahead > 0)
+        next_scan_us = delayed_by_us(now, ahead % KB_SCAN_INTERVAL_US);
+}
+
 void kb_task()
 {
-    static absolute_time_t next_scan_us = {0};
+    kb_params_update();
     absolute_time_t now = get_absolute_time();
     if (absolute_time_diff_us(now, next_scan_us) > 0)
         return;
-    next_scan_us = delayed_by_us(now, KB_SCAN_INTERVAL_US);
+    kb_scans++;
+    health_scan(to_us_since_boot(now));
+    // Stay on the same phase unless we've fallen a whole scan behind.
+    next_scan_us = delayed_by_us(next_scan_us, KB_SCAN_INTERVAL_US);
+    if (absolute_time_diff_us(now, next_scan_us) <= 0)
+        next_scan_us = delayed_by_us(now, KB_SCAN_INTERVAL_US);
 
-    uint8_t kb_col_pop[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    uint8_t kb_row_pop[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    // A capture starts with a full snapshot, then only changes.
+    static bool kb_capturing = false;
+    bool snapshot = capture_on && !kb_capturing;
+    kb_capturing = capture_on;
 
-    hid_keyboard_modifier_bm_t modifier = 0;
+    uint16_t pressed[KB_COLS];
+    uint32_t start = kb_cycles();
+    KB_ACQUIRERS[kb_params.acquire](pressed, snapshot);
+    kb_stage_done(KB_STAGE_ACQUIRE, start);
 
-    // read the matrix, one scan of all columns
-    for (uint col = 0; col < 8; col++)
+    // Only keys that differ from the matrix or are debouncing.
+    void (*debounce)(uint idx, bool is_up) = KB_DEBOUNCERS[kb_params.debounce];
+    start = kb_cycles();
+    for (uint col = 0; col < KB_COLS; col++)
     {
-        gpio_set_dir(8 + col, GPIO_OUT);
-        busy_wait_us_32(KB_CAS_US);
-        uint8_t row_data = gpio_get_all();
-        gpio_set_dir(8 + col, GPIO_IN);
-        for (uint row = 0; row < 8; row++)
+        uint pending = (pressed[col] ^ kb_down[col]) | kb_bouncing[col];
+        for (; pending; pending &= pending - 1)
         {
-            uint idx = row * 8 + col;
-            set_cbm_scan(idx, row_data & (1u << row));
-
-            // current modifier ignores ghosted keys
-            if (cbm_scan[idx].status == 1)
-                modifier |= cbm_to_modifier(idx);
-
-            // population count includes ghosted and bouncing keys
-            if (cbm_scan[idx].status)
-            {
-                ++kb_col_pop[col];
-                ++kb_row_pop[row];
-            }
+            uint row = __builtin_ctz(pending);
+            debounce(row * KB_COLS + col, !(pressed[col] & (1u << row)));
+            kb_mark(row, col);
         }
     }
 
+    // current modifier ignores ghosted keys
+    hid_keyboard_modifier_bm_t modifier = kb_modifier();
+
+#ifdef KB_RESTORE_PIN
     // RESTORE key is not in matrix
-    set_cbm_scan(CBM_KEY_RESTORE, gpio_get(18));
+    debounce(CBM_KEY_RESTORE, gpio_get(KB_RESTORE_PIN));
     if (cbm_scan[CBM_KEY_RESTORE].status > 1)
     {
         cbm_scan[CBM_KEY_RESTORE].status = 1;
+        kb_queued = true;
+        TRACELOG(TRACELOG_KEY_DOWN, CBM_KEY_RESTORE);
         cbm_scan[CBM_KEY_RESTORE].modifier = modifier;
     }
+#endif
+
+#ifdef KB_LATCHES
+    for (uint latch = 0; latch < KB_LATCHES; latch++)
+        set_cbm_latch(latch, gpio_get(KB_LATCH_PIN(latch)));
+#endif
+    kb_stage_done(KB_STAGE_DEBOUNCE, start);
 
-    // use pop count to find ghosted keys
-    for (uint col = 0; col < 8; col++)
+    // The resolver only runs while a key is waiting.
+    uint waiting = 0;
+    for (uint col = 0; col < KB_COLS; col++)
+        waiting |= kb_waiting[col];
+    if (waiting)
     {
-        for (uint row = 0; row < 8; row++)
-        {
-            uint idx = row * 8 + col;
-            if (cbm_scan[idx].status > 1)
-                if (kb_col_pop[col] > 1 && kb_row_pop[row] > 1)
-                    cbm_scan[idx].status = 1 + KB_GHOST_TICKS;
-                else if (--cbm_scan[idx].status == 1)
-                    cbm_scan[idx].modifier = modifier;
-        }
+        start = kb_cycles();
+        KB_GHOST_RESOLVERS[kb_params.ghost](modifier);
+        kb_stage_done(KB_STAGE_GHOST, start);
+    }
+
+    if (!kb_primed)
+    {
+        kb_primed = true;
+        // Modifiers held at power on apply to keys held with them.
+        modifier = kb_modifier();
+        for (uint idx = 0; idx < KB_KEYS; idx++)
+            if (cbm_scan[idx].status == 1)
+                cbm_scan[idx].modifier = modifier;
     }
+
+    if (capture_on)
+        kb_capture_keys(snapshot);
+
+    kb_stage_log(now);
 }
 
-hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
+// Set when kb_report() had to leave a key queued because it conflicts
+// with the report being built. The next report in the sequence is
+// sent on the following host poll instead of waiting for hid_task().
+static bool kb_deferred;
+
+// Report strategies decide when a held back key goes out.
+static bool kb_pending_next_poll()
+{
+    return kb_deferred;
+}
+
+// Left for hid_task() to send at the next report interval.
+static bool kb_pending_interval()
+{
+    return false;
+}
+
+static bool (*const KB_REPORTERS[PARAMS_REPORTS])(void) = {
+    [PARAMS_REPORT_NEXT_POLL] = kb_pending_next_poll,
+    [PARAMS_REPORT_INTERVAL] = kb_pending_interval,
+};
+
+bool kb_report_pending()
+{
+    return KB_REPORTERS[kb_params.report]();
+}
+
+// Both report strategies build reports the same way.
+static hid_keyboard_modifier_bm_t kb_assemble(uint8_t keycode_return[6])
 {
     static hid_keyboard_modifier_bm_t modifier;
     static struct
@@ -451,6 +999,7 @@ hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
 
     bool modifier_locked = false;
     uint code_count = 0;
+    kb_deferred = false;
 
     // remove released keys
     while (code_count < 6)
@@ -468,31 +1017,47 @@ hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
         code_count++;
     }
 
-    // move keys out of queue
-    for (uint cbmcode = 0; cbmcode < 65; cbmcode++)
+    // move keys out of queue, if anything joined it
+    bool queued = kb_queued;
+    kb_queued = false;
+    for (uint cbmcode = 0; queued && cbmcode < KB_KEYS; cbmcode++)
     {
         if (cbm_scan[cbmcode].status == 1 && !cbm_scan[cbmcode].sent)
         {
-            if (!cbm_to_modifier(cbmcode)) // regular keys only
+            // regular keys only, unused matrix positions have no keycode
+            if (CBM_TO_HID[cbmcode] && !cbm_to_modifier(cbmcode) &&
+                !(is_cbm_layer && cbmcode == CBM_KEY_CBM))
             {
                 // check for phantom state
                 if (code_count >= 6)
                 {
+                    kb_health.phantoms++;
                     for (uint idx = 0; idx < 6; idx++)
                         keycode_return[idx] = 1;
+                    kb_queued = true;
                     return 0;
                 }
                 // Pressing + and - in the same report period needs to send a shift
                 // for the + and no shift for the -. This is impossible,
                 // so we leave one queued for the next report.
                 hid_keyboard_modifier_bm_t queued_modifier = cbm_scan[cbmcode].modifier;
-                if (!modifier_locked || modifier == queued_modifier)
+                if (modifier_locked && modifier != queued_modifier)
+                {
+                    kb_deferred = true;
+                    TRACELOG(TRACELOG_DEFER, cbmcode);
+                }
+                else
                 {
                     uint8_t queued_keycode = cbmcode;
-                    if (is_mister)
-                        cbm_translate_mister(&queued_keycode, &queued_modifier);
-                    else
-                        cbm_translate_ascii(&queued_keycode, &queued_modifier);
+                    uint layer = is_cbm_layer && CBM_KEY_CBM < KB_KEYS &&
+                                         cbm_scan[CBM_KEY_CBM].status == 1
+                                     ? KB_LAYER_CBM
+                                     : KB_LAYER_BASE;
+                    const struct kb_translator *translator = &KB_TRANSLATORS[is_mister];
+                    uint32_t start = kb_cycles();
+                    if (!cbm_translate_layer(translator->layers, layer, &queued_keycode, &queued_modifier))
+                        translator->translate(&queued_keycode, &queued_modifier);
+                    kb_stage_done(KB_STAGE_TRANSLATE, start);
                     // Pressing ; and ; simultaneously is the same key with
                     // different shift states. When this is detected, release
                     // the held key so it can be repressed in the next repoort.
@@ -501,6 +1066,8 @@ hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
                         if (codes[i].keycode == queued_keycode)
                         {
                             ok = false;
+                            kb_deferred = true;
+                            TRACELOG(TRACELOG_DEFER, cbmcode);
                             for (uint j = i; j < 5; j++)
                                 codes[j] = codes[j + 1];
                             codes[5].keycode = 0;
@@ -524,10 +1091,7 @@ hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
     // Recompute modifiers in certain situations.
     if (!modifier_locked)
     {
-        hid_keyboard_modifier_bm_t scanned_modifier = 0;
-        for (uint idx = 0; idx < 65; idx++)
-            if (cbm_scan[idx].status == 1)
-                scanned_modifier |= cbm_to_modifier(idx);
+        hid_keyboard_modifier_bm_t scanned_modifier = kb_modifier();
         if (code_count == 0)
             modifier = scanned_modifier;
         if (code_count == 1)
@@ -549,14 +1113,27 @@ hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
                     cbm_scan[codes[0].cbmcode].modifier = scanned_modifier;
                     cbm_scan[codes[0].cbmcode].sent = false;
                     codes[--code_count].keycode = 0;
+                    kb_deferred = true;
+                    TRACELOG(TRACELOG_DEFER, codes[0].cbmcode);
                 }
                 break;
             }
         }
     }
 
+    // Deferred keys are still queued for the next report.
+    kb_queued |= kb_deferred;
+
     // Return new report
     for (uint idx = 0; idx < 6; idx++)
         keycode_return[idx] = codes[idx].keycode;
     return modifier;
 }
+
+hid_keyboard_modifier_bm_t kb_report(uint8_t keycode_return[6])
+{
+    uint32_t start = kb_cycles();
+    hid_keyboard_modifier_bm_t modifier = kb_assemble(keycode_return);
+    kb_stage_done(KB_STAGE_REPORT, start);
+    return modifier;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _KB_C128_H
+#define _KB_C128_H
+
+// Commodore 128 keyboard geometry for kb6.c.
+// K0-K2 are driven like the column lines, as $D02F does, and
+// the 24 extra keys join them to the same 8 rows.
+
+#include "kb_c64_keys.h"
+
+// Rows 0-7 on GP0-7, read with pull-ups
+// "column" pins 12-5 on GP8-15 and K0-K2 on GP19-21 as columns 8-10,
+// driven low one at a time
+#define KB_ROWS 8
+#define KB_COLS 11
+#define KB_ROW_PIN(row) (row)
+#define KB_COL_PIN(col) ((col) < 8 ? 8 + (col) : 11 + (col))
+#define KB_ROW_DATA(gpio) ((gpio) & 0xFF)
+
+// RESTORE key not part of matrix, on GP18
+#define KB_RESTORE_PIN 18
+
+// 40/80 DISPLAY on GP22 and CAPS LOCK on GP26 latch down.
+#define KB_LATCHES 2
+#define KB_LATCH_PIN(latch) ((latch) ? 26 : 22)
+
+#define KB_KEYS 91
+#define KB_FORCE_SHIFT(cbmcode) false
+
+// Each row is the C64's 8 columns then K0, K1 and K2.
+static const uint8_t CBM_TO_HID[KB_KEYS] = {
+    KB_C64_ROW_0_TO_HID, HID_KEY_HELP, HID_KEY_ESCAPE, HID_KEY_ALT_RIGHT,                   // 0-10
+    KB_C64_ROW_1_TO_HID, HID_KEY_KEYPAD_8, HID_KEY_KEYPAD_ADD, HID_KEY_KEYPAD_0,            // 11-21
+    KB_C64_ROW_2_TO_HID, HID_KEY_KEYPAD_5, HID_KEY_KEYPAD_SUBTRACT, HID_KEY_KEYPAD_DECIMAL, // 22-32
+    KB_C64_ROW_3_TO_HID, HID_KEY_TAB, HID_KEY_F13, HID_KEY_ARROW_UP,                        // 33-43
+    KB_C64_ROW_4_TO_HID, HID_KEY_KEYPAD_2, HID_KEY_KEYPAD_ENTER, HID_KEY_ARROW_DOWN,        // 44-54
+    KB_C64_ROW_5_TO_HID, HID_KEY_KEYPAD_4, HID_KEY_KEYPAD_6, HID_KEY_ARROW_LEFT,            // 55-65
+    KB_C64_ROW_6_TO_HID, HID_KEY_KEYPAD_7, HID_KEY_KEYPAD_9, HID_KEY_ARROW_RIGHT,           // 66-76
+    KB_C64_ROW_7_TO_HID, HID_KEY_KEYPAD_1, HID_KEY_KEYPAD_3, HID_KEY_SCROLL_LOCK,           // 77-87
+    HID_KEY_F11, HID_KEY_F14, HID_KEY_CAPS_LOCK                                             // 88-90
+};
+
+#define CBM_KEY_RESTORE 88
+#define CBM_KEY_40_80 89
+#define CBM_KEY_CAPS_LOCK 90
+#define CBM_KEY_LATCH(latch) (CBM_KEY_40_80 + (latch))
+
+#endif
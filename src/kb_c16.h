@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _KB_C16_H
+#define _KB_C16_H
+
+// Commodore 16 and Plus/4 keyboard geometry for kb6.c.
+// An 8x8 matrix like the C64 but laid out differently, with
+// four separate cursor keys, ESC, HELP, F1-F3 and no RESTORE.
+
+// The 8 TED K lines on GP0-7, read with pull-ups
+// The 8 keyboard latch lines on GP8-15, driven low one at a time
+#define KB_ROWS 8
+#define KB_COLS 8
+#define KB_ROW_PIN(row) (row)
+#define KB_COL_PIN(col) (8 + (col))
+#define KB_ROW_DATA(gpio) ((gpio) & 0xFF)
+
+#define KB_KEYS 64
+#define KB_FORCE_SHIFT(cbmcode) false
+
+// Symbol keys use the same positional codes as the C64 so
+// the ASCII translation treats them the same way.
+static const uint8_t CBM_TO_HID[KB_KEYS] = {
+    HID_KEY_DELETE, HID_KEY_3, HID_KEY_5, HID_KEY_7,                // 0-3
+    HID_KEY_9, HID_KEY_ARROW_DOWN, HID_KEY_ARROW_LEFT, HID_KEY_1,   // 4-7
+    HID_KEY_ENTER, HID_KEY_W, HID_KEY_R, HID_KEY_Y,                 // 8-11
+    HID_KEY_I, HID_KEY_P, HID_KEY_BRACKET_RIGHT, HID_KEY_HOME,      // 12-15
+    HID_KEY_BACKSLASH, HID_KEY_A, HID_KEY_D, HID_KEY_G,             // 16-19
+    HID_KEY_J, HID_KEY_L, HID_KEY_APOSTROPHE, HID_KEY_CONTROL_LEFT, // 20-23
+    HID_KEY_HELP, HID_KEY_4, HID_KEY_6, HID_KEY_8,                  // 24-27
+    HID_KEY_0, HID_KEY_ARROW_UP, HID_KEY_ARROW_RIGHT, HID_KEY_2,    // 28-31
+    HID_KEY_F1, HID_KEY_Z, HID_KEY_C, HID_KEY_B,                    // 32-35
+    HID_KEY_M, HID_KEY_PERIOD, HID_KEY_ESCAPE, HID_KEY_SPACE,       // 36-39
+    HID_KEY_F2, HID_KEY_S, HID_KEY_F, HID_KEY_H,                    // 40-43
+    HID_KEY_K, HID_KEY_SEMICOLON, HID_KEY_END, HID_KEY_ALT_LEFT,    // 44-47
+    HID_KEY_F3, HID_KEY_E, HID_KEY_T, HID_KEY_U,                    // 48-51
+    HID_KEY_O, HID_KEY_MINUS, HID_KEY_EQUAL, HID_KEY_Q,             // 52-55
+    HID_KEY_BRACKET_LEFT, HID_KEY_SHIFT_LEFT, HID_KEY_X, HID_KEY_V, // 56-59
+    HID_KEY_N, HID_KEY_COMMA, HID_KEY_SLASH, HID_KEY_PAUSE          // 60-63
+};
+
+#define CBM_KEY_1 7
+#define CBM_KEY_2 31
+#define CBM_KEY_3 1
+#define CBM_KEY_4 25
+#define CBM_KEY_5 2
+#define CBM_KEY_6 26
+#define CBM_KEY_7 3
+#define CBM_KEY_8 27
+#define CBM_KEY_9 4
+#define CBM_KEY_0 28
+#define CBM_KEY_CONTROL_LEFT 23
+#define CBM_KEY_RUN_STOP 63
+#define CBM_KEY_SPACE 39
+#define CBM_KEY_CBM 47 // C= key
+#define CBM_KEY_SHIFT_LEFT 57
+#define CBM_KEY_PLUS 54
+#define CBM_KEY_COMMA 61
+#define CBM_KEY_PERIOD 37
+#define CBM_KEY_COLON 45
+#define CBM_KEY_COMMERCIAL_AT 56
+#define CBM_KEY_MINUS 53
+#define CBM_KEY_STERLING 16
+#define CBM_KEY_ASTERISK 14
+#define CBM_KEY_SEMICOLON 22
+#define CBM_KEY_SLASH 62
+#define CBM_KEY_EQUAL 46
+#define CBM_KEY_HOME 15
+#define CBM_KEY_DEL 0
+#define CBM_KEY_RETURN 8
+
+// Keys this keyboard doesn't have never match.
+// The cursor keys are separate so need no SHIFT handling.
+#define CBM_KEY_ARROW_LEFT (KB_KEYS + 0)
+#define CBM_KEY_SHIFT_RIGHT (KB_KEYS + 1)
+#define CBM_KEY_ARROW_UP (KB_KEYS + 2)
+#define CBM_KEY_CRSR_RIGHT (KB_KEYS + 3)
+#define CBM_KEY_CRSR_DOWN (KB_KEYS + 4)
+#define CBM_KEY_F1 (KB_KEYS + 5)
+#define CBM_KEY_F3 (KB_KEYS + 6)
+#define CBM_KEY_F5 (KB_KEYS + 7)
+#define CBM_KEY_F7 (KB_KEYS + 8)
+#define CBM_KEY_RESTORE (KB_KEYS + 9)
+
+#endif
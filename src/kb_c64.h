@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _KB_C64_H
+#define _KB_C64_H
+
+// Commodore 64 keyboard geometry for kb6.c.
+// The VIC-20 keyboard has the same matrix and connector.
+
+#include "kb_c64_keys.h"
+
+// "row data" pins 20-13 on GP0-7, read with pull-ups
+// "column" pins 12-5 on GP8-15, driven low one at a time
+#define KB_ROWS 8
+#define KB_COLS 8
+#define KB_ROW_PIN(row) (row)
+#define KB_COL_PIN(col) (8 + (col))
+#define KB_ROW_DATA(gpio) ((gpio) & 0xFF)
+
+// RESTORE key not part of matrix
+// pin 1 to ground, pin 3 to GP18
+#define KB_RESTORE_PIN 18
+
+#define KB_KEYS 65
+#define KB_FORCE_SHIFT(cbmcode) false
+
+static const uint8_t CBM_TO_HID[KB_KEYS] = {
+    KB_C64_MATRIX_TO_HID,
+    HID_KEY_F11 // 64
+};
+
+#define CBM_KEY_RESTORE 64
+
+#endif
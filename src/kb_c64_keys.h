@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _KB_C64_KEYS_H
+#define _KB_C64_KEYS_H
+
+// The 8x8 matrix shared by the C64, VIC-20 and C128 keyboards.
+
+// Default keycode translations are the positional mapping used by MiSTer.
+// These keycodes are unique to how the Pi Pico is wired and scanned.
+// One row of 8 columns each, so a wider matrix can add its own columns.
+#define KB_C64_ROW_0_TO_HID                                      \
+    HID_KEY_1, HID_KEY_GRAVE, HID_KEY_CONTROL_LEFT, HID_KEY_ESCAPE, \
+        HID_KEY_SPACE, HID_KEY_ALT_LEFT, HID_KEY_Q, HID_KEY_2
+#define KB_C64_ROW_1_TO_HID                       \
+    HID_KEY_3, HID_KEY_W, HID_KEY_A, HID_KEY_SHIFT_LEFT, \
+        HID_KEY_Z, HID_KEY_S, HID_KEY_E, HID_KEY_4
+#define KB_C64_ROW_2_TO_HID             \
+    HID_KEY_5, HID_KEY_R, HID_KEY_D, HID_KEY_X, \
+        HID_KEY_C, HID_KEY_F, HID_KEY_T, HID_KEY_6
+#define KB_C64_ROW_3_TO_HID             \
+    HID_KEY_7, HID_KEY_Y, HID_KEY_G, HID_KEY_V, \
+        HID_KEY_B, HID_KEY_H, HID_KEY_U, HID_KEY_8
+#define KB_C64_ROW_4_TO_HID             \
+    HID_KEY_9, HID_KEY_I, HID_KEY_J, HID_KEY_N, \
+        HID_KEY_M, HID_KEY_K, HID_KEY_O, HID_KEY_0
+#define KB_C64_ROW_5_TO_HID                                           \
+    HID_KEY_EQUAL, HID_KEY_P, HID_KEY_L, HID_KEY_COMMA,                   \
+        HID_KEY_PERIOD, HID_KEY_SEMICOLON, HID_KEY_BRACKET_LEFT, HID_KEY_MINUS
+#define KB_C64_ROW_6_TO_HID                                                 \
+    HID_KEY_BACKSLASH, HID_KEY_BRACKET_RIGHT, HID_KEY_APOSTROPHE, HID_KEY_SLASH, \
+        HID_KEY_SHIFT_RIGHT, HID_KEY_END, HID_KEY_PAGE_DOWN, HID_KEY_HOME
+#define KB_C64_ROW_7_TO_HID                                            \
+    HID_KEY_DELETE, HID_KEY_ENTER, HID_KEY_ARROW_RIGHT, HID_KEY_ARROW_DOWN, \
+        HID_KEY_F1, HID_KEY_F3, HID_KEY_F5, HID_KEY_F7
+#define KB_C64_MATRIX_TO_HID                                         \
+    KB_C64_ROW_0_TO_HID, KB_C64_ROW_1_TO_HID, KB_C64_ROW_2_TO_HID,   \
+        KB_C64_ROW_3_TO_HID, KB_C64_ROW_4_TO_HID, KB_C64_ROW_5_TO_HID, \
+        KB_C64_ROW_6_TO_HID, KB_C64_ROW_7_TO_HID // 0-63
+
+// CBM codes are row * KB_COLS + column. These are numbered as on
+// the 8 column C64 and land on the same key when there are more.
+#define KB_C64_KEY(code) ((code) / 8 * KB_COLS + (code) % 8)
+
+// All the keys except letters
+#define CBM_KEY_1 KB_C64_KEY(0)
+#define CBM_KEY_2 KB_C64_KEY(7)
+#define CBM_KEY_3 KB_C64_KEY(8)
+#define CBM_KEY_4 KB_C64_KEY(15)
+#define CBM_KEY_5 KB_C64_KEY(16)
+#define CBM_KEY_6 KB_C64_KEY(23)
+#define CBM_KEY_7 KB_C64_KEY(24)
+#define CBM_KEY_8 KB_C64_KEY(31)
+#define CBM_KEY_9 KB_C64_KEY(32)
+#define CBM_KEY_0 KB_C64_KEY(39)
+#define CBM_KEY_ARROW_LEFT KB_C64_KEY(1)
+#define CBM_KEY_CONTROL_LEFT KB_C64_KEY(2)
+#define CBM_KEY_RUN_STOP KB_C64_KEY(3)
+#define CBM_KEY_SPACE KB_C64_KEY(4)
+#define CBM_KEY_CBM KB_C64_KEY(5) // C= key
+#define CBM_KEY_SHIFT_LEFT KB_C64_KEY(11)
+#define CBM_KEY_PLUS KB_C64_KEY(40)
+#define CBM_KEY_COMMA KB_C64_KEY(43)
+#define CBM_KEY_PERIOD KB_C64_KEY(44)
+#define CBM_KEY_COLON KB_C64_KEY(45)
+#define CBM_KEY_COMMERCIAL_AT KB_C64_KEY(46)
+#define CBM_KEY_MINUS KB_C64_KEY(47)
+#define CBM_KEY_STERLING KB_C64_KEY(48)
+#define CBM_KEY_ASTERISK KB_C64_KEY(49)
+#define CBM_KEY_SEMICOLON KB_C64_KEY(50)
+#define CBM_KEY_SLASH KB_C64_KEY(51)
+#define CBM_KEY_SHIFT_RIGHT KB_C64_KEY(52)
+#define CBM_KEY_EQUAL KB_C64_KEY(53)
+#define CBM_KEY_ARROW_UP KB_C64_KEY(54)
+#define CBM_KEY_HOME KB_C64_KEY(55)
+#define CBM_KEY_DEL KB_C64_KEY(56)
+#define CBM_KEY_RETURN KB_C64_KEY(57)
+#define CBM_KEY_CRSR_RIGHT KB_C64_KEY(58)
+#define CBM_KEY_CRSR_DOWN KB_C64_KEY(59)
+#define CBM_KEY_F1 KB_C64_KEY(60)
+#define CBM_KEY_F3 KB_C64_KEY(61)
+#define CBM_KEY_F5 KB_C64_KEY(62)
+#define CBM_KEY_F7 KB_C64_KEY(63)
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _KB_PET_H
+#define _KB_PET_H
+
+// PET graphics keyboard geometry for kb6.c, as on the 2001N,
+// 3000 and 4000 series. Ten rows are strobed instead of eight.
+// Every symbol has its own key, so the ASCII translation adds
+// SHIFT where a PC keyboard needs it. SHIFT itself only selects
+// graphics on a PET.
+
+// The 8 PIA port B lines on GP0-7, read with pull-ups
+// Keyboard rows 0-9 on GP8-15 and GP19-20, driven low one at a time
+#define KB_ROWS 8
+#define KB_COLS 10
+#define KB_ROW_PIN(row) (row)
+#define KB_COL_PIN(col) ((col) < 8 ? 8 + (col) : 11 + (col))
+#define KB_ROW_DATA(gpio) ((gpio) & 0xFF)
+
+#define KB_KEYS 80
+#define KB_FORCE_SHIFT(cbmcode) KB_SHIFTED[cbmcode]
+
+// Keys for symbols that are shifted on a PC keyboard
+static const bool KB_SHIFTED[KB_KEYS] = {
+    [0] = true,  // !
+    [1] = true,  // "
+    [10] = true, // #
+    [11] = true, // $
+    [18] = true, // @
+    [20] = true, // %
+    [30] = true, // &
+    [39] = true, // <
+    [40] = true, // (
+    [41] = true, // )
+    [45] = true, // :
+    [47] = true, // ?
+    [48] = true, // >
+    [75] = true, // *
+    [77] = true, // +
+};
+
+static const uint8_t CBM_TO_HID[KB_KEYS] = {
+    HID_KEY_1, HID_KEY_APOSTROPHE, HID_KEY_Q, HID_KEY_W, HID_KEY_A,                      // 0-4
+    HID_KEY_S, HID_KEY_Z, HID_KEY_X, HID_KEY_SHIFT_LEFT, HID_KEY_ALT_LEFT,               // 5-9
+    HID_KEY_3, HID_KEY_4, HID_KEY_E, HID_KEY_R, HID_KEY_D,                               // 10-14
+    HID_KEY_F, HID_KEY_C, HID_KEY_V, HID_KEY_2, HID_KEY_BRACKET_LEFT,                    // 15-19
+    HID_KEY_5, HID_KEY_APOSTROPHE, HID_KEY_T, HID_KEY_Y, HID_KEY_G,                      // 20-24
+    HID_KEY_H, HID_KEY_B, HID_KEY_N, HID_KEY_BRACKET_RIGHT, HID_KEY_SPACE,               // 25-29
+    HID_KEY_7, HID_KEY_BACKSLASH, HID_KEY_U, HID_KEY_I, HID_KEY_J,                       // 30-34
+    HID_KEY_K, HID_KEY_M, HID_KEY_COMMA, HID_KEY_NONE, HID_KEY_COMMA,                    // 35-39
+    HID_KEY_9, HID_KEY_0, HID_KEY_O, HID_KEY_P, HID_KEY_L,                               // 40-44
+    HID_KEY_SEMICOLON, HID_KEY_SEMICOLON, HID_KEY_SLASH, HID_KEY_PERIOD, HID_KEY_ESCAPE, // 45-49
+    HID_KEY_GRAVE, HID_KEY_NONE, HID_KEY_PAGE_DOWN, HID_KEY_NONE, HID_KEY_NONE,          // 50-54
+    HID_KEY_NONE, HID_KEY_ENTER, HID_KEY_NONE, HID_KEY_SHIFT_RIGHT, HID_KEY_NONE,        // 55-59
+    HID_KEY_HOME, HID_KEY_ARROW_DOWN, HID_KEY_7, HID_KEY_8, HID_KEY_4,                   // 60-64
+    HID_KEY_5, HID_KEY_1, HID_KEY_2, HID_KEY_0, HID_KEY_PERIOD,                          // 65-69
+    HID_KEY_ARROW_RIGHT, HID_KEY_DELETE, HID_KEY_9, HID_KEY_SLASH, HID_KEY_6,            // 70-74
+    HID_KEY_8, HID_KEY_3, HID_KEY_EQUAL, HID_KEY_MINUS, HID_KEY_EQUAL                    // 75-79
+};
+
+#define CBM_KEY_ARROW_LEFT 50
+#define CBM_KEY_RUN_STOP 49
+#define CBM_KEY_SPACE 29
+#define CBM_KEY_CBM 9 // RVS key, TAB like C=
+#define CBM_KEY_SHIFT_LEFT 8
+#define CBM_KEY_SHIFT_RIGHT 58
+#define CBM_KEY_ARROW_UP 52
+#define CBM_KEY_HOME 60
+#define CBM_KEY_DEL 71
+#define CBM_KEY_RETURN 56
+#define CBM_KEY_CRSR_RIGHT 70
+#define CBM_KEY_CRSR_DOWN 61
+
+// Keys this keyboard doesn't have never match. The symbol and
+// number keys are left out since they need no translation.
+#define CBM_KEY_1 (KB_KEYS + 0)
+#define CBM_KEY_2 (KB_KEYS + 1)
+#define CBM_KEY_3 (KB_KEYS + 2)
+#define CBM_KEY_4 (KB_KEYS + 3)
+#define CBM_KEY_5 (KB_KEYS + 4)
+#define CBM_KEY_6 (KB_KEYS + 5)
+#define CBM_KEY_7 (KB_KEYS + 6)
+#define CBM_KEY_8 (KB_KEYS + 7)
+#define CBM_KEY_9 (KB_KEYS + 8)
+#define CBM_KEY_0 (KB_KEYS + 9)
+#define CBM_KEY_CONTROL_LEFT (KB_KEYS + 10)
+#define CBM_KEY_PLUS (KB_KEYS + 11)
+#define CBM_KEY_COMMA (KB_KEYS + 12)
+#define CBM_KEY_PERIOD (KB_KEYS + 13)
+#define CBM_KEY_COLON (KB_KEYS + 14)
+#define CBM_KEY_COMMERCIAL_AT (KB_KEYS + 15)
+#define CBM_KEY_MINUS (KB_KEYS + 16)
+#define CBM_KEY_STERLING (KB_KEYS + 17)
+#define CBM_KEY_ASTERISK (KB_KEYS + 18)
+#define CBM_KEY_SEMICOLON (KB_KEYS + 19)
+#define CBM_KEY_SLASH (KB_KEYS + 20)
+#define CBM_KEY_EQUAL (KB_KEYS + 21)
+#define CBM_KEY_F1 (KB_KEYS + 22)
+#define CBM_KEY_F3 (KB_KEYS + 23)
+#define CBM_KEY_F5 (KB_KEYS + 24)
+#define CBM_KEY_F7 (KB_KEYS + 25)
+#define CBM_KEY_RESTORE (KB_KEYS + 26)
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "capture.h"
+#include <string.h>
+
+volatile bool capture_on;
+
+static struct capture_event capture_buf[CAPTURE_EVENTS];
+static uint capture_count;
+static uint capture_offset; // read position in bytes
+
+void capture_event(uint8_t type, uint8_t idx, uint16_t data)
+{
+    if (capture_count >= CAPTURE_EVENTS)
+    {
+        capture_on = false;
+        return;
+    }
+    struct capture_event *ev = &capture_buf[capture_count++];
+    ev->us = time_us_32();
+    ev->type = type;
+    ev->idx = idx;
+    ev->data = data;
+}
+
+void capture_start(void)
+{
+    capture_count = 0;
+    capture_offset = 0;
+    capture_on = true;
+    capture_event(CAPTURE_START, 0, 0);
+}
+
+void capture_stop(void)
+{
+    capture_on = false;
+}
+
+const struct capture_event *capture_events(uint *count)
+{
+    *count = capture_count;
+    return capture_buf;
+}
+
+void capture_set_report(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < 1)
+        return;
+    switch (buffer[0])
+    {
+    case CAPTURE_CMD_STOP:
+        capture_stop();
+        break;
+    case CAPTURE_CMD_START:
+        capture_start();
+        break;
+    case CAPTURE_CMD_SEEK:
+        if (bufsize >= 5)
+            capture_offset = buffer[1] | buffer[2] << 8 |
+                             buffer[3] << 16 | (uint32_t)buffer[4] << 24;
+        break;
+    }
+}
+
+uint16_t capture_get_report(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < CAPTURE_REPORT_LEN)
+        return 0;
+    memset(buffer, 0, CAPTURE_REPORT_LEN);
+    // Nothing is read out while events are still being added.
+    uint total = capture_on ? 0 : capture_count * sizeof(struct capture_event);
+    uint len = 0;
+    if (capture_offset < total)
+        len = MIN(total - capture_offset, CAPTURE_CHUNK);
+    buffer[0] = capture_on;
+    buffer[1] = len;
+    buffer[2] = capture_count;
+    buffer[3] = capture_count >> 8;
+    for (uint i = 0; i < 4; i++)
+        buffer[4 + i] = capture_offset >> (8 * i);
+    memcpy(&buffer[8], (uint8_t *)capture_buf + capture_offset, len);
+    capture_offset += len;
+    return CAPTURE_REPORT_LEN;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+// Timestamped event capture for studying scan and report timing
+// without a logic analyser. Events go into a RAM buffer until it
+// fills, then the host reads it out and host/capture2vcd makes
+// a VCD file for GTKWave.
+
+#include "pico/stdlib.h"
+
+#define CAPTURE_EVENTS 4096
+
+enum capture_type
+{
+    CAPTURE_START,  // idx=0, data=0
+    CAPTURE_ROWS,   // idx=column strobe, data=raw row lines, low is closed
+    CAPTURE_KEY,    // idx=cbmcode, data=1 pressed or 0 released, debounced
+    CAPTURE_GHOST,  // idx=cbmcode, data=1 held back as a ghost or 0 cleared
+    CAPTURE_REPORT, // idx=0-3, data=two report bytes, modifier first
+};
+
+// 8 bytes, little endian, also the record format of capture files
+struct capture_event
+{
+    uint32_t us;
+    uint8_t type;
+    uint8_t idx;
+    uint16_t data;
+};
+
+// Capture file header, followed by the events
+#define CAPTURE_MAGIC "CBMCAP1"
+
+extern volatile bool capture_on;
+
+void capture_event(uint8_t type, uint8_t idx, uint16_t data);
+
+// Cheap enough to leave in the scan loop
+static inline void capture(uint8_t type, uint8_t idx, uint16_t data)
+{
+    if (capture_on)
+        capture_event(type, idx, data);
+}
+
+void capture_start(void);
+void capture_stop(void);
+const struct capture_event *capture_events(uint *count);
+
+// Report ID 1 feature reports on the debug interface. SET takes
+// a command byte then a little endian byte offset for SEEK. GET
+// returns state, event count and offset, then the next 56 bytes
+// of events, and advances the offset.
+#define CAPTURE_CMD_STOP 0
+#define CAPTURE_CMD_START 1
+#define CAPTURE_CMD_SEEK 2
+#define CAPTURE_REPORT_LEN 63
+#define CAPTURE_CHUNK 56
+
+void capture_set_report(uint8_t const *buffer, uint16_t bufsize);
+uint16_t capture_get_report(uint8_t *buffer, uint16_t reqlen);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "health.h"
+#include "params.h"
+#include <string.h>
+
+static_assert(sizeof(struct health) <= HEALTH_REPORT_LEN);
+
+struct health kb_health = {.version = HEALTH_VERSION};
+
+static uint64_t health_last_scan_us;
+static uint64_t health_second_us;
+static uint32_t health_second_scans;
+
+void health_scan(uint64_t now_us)
+{
+    if (health_last_scan_us)
+    {
+        uint32_t gap = now_us - health_last_scan_us;
+        if (gap > kb_health.scan_gap_us)
+            kb_health.scan_gap_us = gap;
+    }
+    health_last_scan_us = now_us;
+    kb_health.scans++;
+    if (now_us - health_second_us >= 1000000)
+    {
+        kb_health.scan_rate = health_second_scans;
+        health_second_scans = 0;
+        health_second_us = now_us;
+    }
+    health_second_scans++;
+}
+
+void health_restart(void)
+{
+    health_last_scan_us = 0;
+    health_second_scans = 0;
+    health_second_us = time_us_64();
+}
+
+uint16_t health_get_report(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < HEALTH_REPORT_LEN)
+        return 0;
+    kb_health.uptime_ms = time_us_64() / 1000;
+    kb_health.scan_interval_us = kb_params.scan_interval_us;
+    memset(buffer, 0, HEALTH_REPORT_LEN);
+    memcpy(buffer, &kb_health, sizeof(kb_health));
+    kb_health.scan_gap_us = 0;
+    kb_health.tud_task_us = 0;
+    return HEALTH_REPORT_LEN;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _HEALTH_H
+#define _HEALTH_H
+
+// Counters for keeping an eye on the main loop's real-time health,
+// read as report ID 3 feature reports on the debug interface. Each is
+// an increment or compare where it happens. Worst cases cover the time
+// since the last read, totals run from power on.
+
+#include "pico/stdlib.h"
+
+// Little endian, also the report layout. Bump the version
+// when the layout changes.
+#define HEALTH_VERSION 2
+struct health
+{
+    uint32_t version;
+    uint32_t uptime_ms;
+    uint32_t scans;
+    uint32_t scan_rate;        // scans in the last whole second
+    uint32_t scan_gap_us;      // worst time between scans
+    uint32_t scan_interval_us; // what it should be
+    uint32_t report_misses;    // report intervals that went by without one
+    uint32_t tud_task_us;      // worst tud_task()
+    uint32_t phantoms;         // reports with more keys than fit
+    uint32_t ghosts;           // keys held back as ghosts
+    uint32_t sof_misses;       // frames the SOF interrupt didn't time
+};
+
+extern struct health kb_health;
+
+// Scanners call this once per scan.
+void health_scan(uint64_t now_us);
+
+// The next scan doesn't count the gap, like after a suspend.
+void health_restart(void);
+
+#define HEALTH_REPORT_LEN 63
+
+uint16_t health_get_report(uint8_t *buffer, uint16_t reqlen);
+
+#endif
@@ -24,73 +24,648 @@
  */
 
 #include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/irq.h"
+#include "hardware/structs/usb.h"
+#include "hardware/sync.h"
+#include "hardware/uart.h"
 
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "tusb.h"
 #include "usb_descriptors.h"
 #include "get_serial.h"
+#include "capture.h"
+#include "params.h"
+#include "health.h"
+#include "tracelog.h"
+#ifdef CBM_MOUSE
+#include "mouse.h"
+#endif
+#ifdef CBM_PADDLES
+#include "paddles.h"
+#endif
+#ifdef CBM_PS2
+#include "ps2.h"
+#endif
 
 void hid_task(void);
+static void mouse_hid_task(void);
+static void paddles_hid_task(void);
+static void ps2_hid_task(void);
+static void suspend_task(void);
+static void sof_init(void);
+static bool sof_task(absolute_time_t scanned);
+static void tracelog_init(void);
+static void tracelog_task(void);
+static void tracelog_pause(void);
+static void params_load(void);
+static void params_task(void);
 
 // declares for src/kb*.c
 extern hid_keyboard_modifier_bm_t kb_report(uint8_t keycode[6]);
 extern void kb_init(void);
 extern void kb_task(void);
+extern bool kb_suspend(gpio_irq_callback_t wake);
+extern void kb_resume(void);
+extern bool kb_report_pending(void);
+extern void kb_sync(absolute_time_t scan_at);
+
+// Scanners without a low power suspend keep scanning while suspended.
+__attribute__((weak)) bool kb_suspend(gpio_irq_callback_t wake)
+{
+    (void)wake;
+    return false;
+}
+__attribute__((weak)) void kb_resume(void) {}
+
+// Scanners without a report sequencer only report from hid_task().
+__attribute__((weak)) bool kb_report_pending(void)
+{
+    return false;
+}
+
+// Scanners that can't be phased to the USB frame free-run.
+__attribute__((weak)) void kb_sync(absolute_time_t scan_at)
+{
+    (void)scan_at;
+}
+
+// Microseconds since reset when each boot phase finished.
+static struct
+{
+    uint32_t main;
+    uint32_t kb_init;
+    uint32_t first_scan;
+    uint32_t usb_init;
+    uint32_t mounted;
+    uint32_t first_report;
+} boot_us;
 
 /*------------- MAIN -------------*/
 int main(void)
 {
+    boot_us.main = time_us_32();
+
+    // The keyboard comes up first and is scanned while USB enumerates,
+    // so keys held during plug-in are known before the host asks.
+    params_load();
+    kb_init();
+    boot_us.kb_init = time_us_32();
+    kb_task();
+    boot_us.first_scan = time_us_32();
+
+    tracelog_init();
     gpio_init(PICO_DEFAULT_LED_PIN);
     gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
     usb_serial_init();
     tud_init(BOARD_TUD_RHPORT);
-    kb_init();
+    sof_init();
+#ifdef CBM_MOUSE
+    mouse_init();
+#endif
+#ifdef CBM_PADDLES
+    paddles_init();
+#endif
+#ifdef CBM_PS2
+    ps2_init();
+#endif
+    boot_us.usb_init = time_us_32();
 
     while (1)
     {
+        uint32_t tud_start = time_us_32();
         tud_task();
+        uint32_t tud_us = time_us_32() - tud_start;
+        if (tud_us > kb_health.tud_task_us)
+            kb_health.tud_task_us = tud_us;
+        if (tud_suspended())
+            suspend_task();
+        absolute_time_t scanned = get_absolute_time();
         kb_task();
-        hid_task();
+        if (sof_task(scanned))
+            hid_task();
+        ps2_hid_task();
+        mouse_hid_task();
+        paddles_hid_task();
+        tracelog_task();
+        params_task();
     }
 
     return 0;
 }
 
+//--------------------------------------------------------------------+
+// USB suspend
+//--------------------------------------------------------------------+
+
+// Microseconds since reset of the last keypress wake.
+static volatile struct
+{
+    uint32_t edge;
+    uint32_t signalled;
+    uint32_t resumed;
+    bool accepted;
+} wake_us;
+
+#ifndef CBM_PS2
+// Runs in the GPIO interrupt, so resume signalling starts
+// without waiting for the main loop to come around.
+static void wake_cb(uint gpio, uint32_t events)
+{
+    (void)gpio;
+    (void)events;
+    if (wake_us.edge)
+        return;
+    wake_us.edge = time_us_32();
+    wake_us.accepted = tud_remote_wakeup();
+    wake_us.signalled = time_us_32();
+}
+#endif
+
+// After a keypress wake the matrix is scanned while the host resumes,
+// which takes tens of milliseconds, so the keys typed meanwhile aren't
+// missed. If the host doesn't resume in this time we sleep again.
+#define WAKE_SCAN_MS 1000
+
+// While the host has us suspended the matrix isn't scanned at all.
+// The scanner drives every column and arms edge interrupts on the rows
+// and RESTORE, the system PLL is shut down with clk_sys running from
+// the 48MHz USB PLL, and the core sleeps until USB or a key wakes it.
+// The USB PLL must keep running for the controller to see bus resume.
+// A PS/2 host doesn't care what USB is doing.
+static void suspend_task(void)
+{
+#ifndef CBM_PS2
+    if (wake_us.edge && time_us_32() - wake_us.edge < WAKE_SCAN_MS * 1000)
+        return;
+    wake_us.edge = 0;
+    if (!kb_suspend(wake_cb))
+        return;
+    uint32_t sys_khz = clock_get_hz(clk_sys) / 1000;
+    tracelog_pause();
+    set_sys_clock_48mhz();
+
+    while (tud_suspended() && !wake_us.edge)
+    {
+        // WFI still wakes on an interrupt masked here, which closes
+        // the race with an event arriving just before sleeping.
+        uint32_t status = save_and_disable_interrupts();
+        if (!tud_task_event_ready() && !wake_us.edge)
+            __wfi();
+        restore_interrupts(status);
+        tud_task();
+    }
+
+    // set_sys_clock_48mhz() also moved clk_peri to the USB PLL, and
+    // set_sys_clock_khz() leaves it there. Put it back on clk_sys as
+    // at boot so the UART divider is right again.
+    set_sys_clock_khz(sys_khz, true);
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS,
+                    sys_khz * 1000, sys_khz * 1000);
+    kb_resume();
+    health_restart();
+#endif
+}
+
+// Reports built while suspended, from the wake keystroke on, are kept
+// and replayed in order once the host is listening again. One older
+// than kb_params.wake_expire_ms by then is dropped rather than typed late.
+#define WAKE_REPORTS 32
+
+static struct
+{
+    uint32_t us;
+    uint8_t modifier;
+    uint8_t keycode[6];
+} wake_reports[WAKE_REPORTS];
+static uint wake_count;
+static uint wake_next;
+
+#ifndef CBM_PS2
+// Only changes are kept, starting from nothing held. When it's full
+// the newest replaces the last, so at least the keys end up right.
+static void wake_report_put(uint8_t modifier, const uint8_t keycode[6])
+{
+    static const uint8_t none[6] = {0};
+    uint8_t last_modifier = wake_count ? wake_reports[wake_count - 1].modifier : 0;
+    const uint8_t *last_keycode = wake_count ? wake_reports[wake_count - 1].keycode : none;
+    if (modifier == last_modifier && !memcmp(keycode, last_keycode, 6))
+        return;
+    uint idx = wake_count < WAKE_REPORTS ? wake_count++ : WAKE_REPORTS - 1;
+    wake_reports[idx].us = time_us_32();
+    wake_reports[idx].modifier = modifier;
+    memcpy(wake_reports[idx].keycode, keycode, 6);
+}
+#endif
+
+static bool wake_report_get(uint8_t *modifier, uint8_t keycode[6])
+{
+    while (wake_next < wake_count)
+    {
+        uint idx = wake_next++;
+        uint32_t expire_ms = kb_params.wake_expire_ms;
+        if (expire_ms && time_us_32() - wake_reports[idx].us > expire_ms * 1000)
+            continue;
+        *modifier = wake_reports[idx].modifier;
+        memcpy(keycode, wake_reports[idx].keycode, 6);
+        return true;
+    }
+    wake_count = wake_next = 0;
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// USB frame sync
+//--------------------------------------------------------------------+
+
+// The host polls once per 1ms frame, so a report built at a random
+// point in the frame waits up to 1ms for the IN token. Instead, each
+// frame the scan is phased to start SOF_LEAD_US before the next SOF,
+// and the report is built straight after it.
+#define SOF_LEAD_US 100
+#define SOF_FRAME_US 1000
+static bool sof_sync = true; // can be false to free-run
+
+// Time of the last start of frame, taken in the USB interrupt.
+static volatile uint32_t sof_us;
+static volatile bool sof_stamped; // sof_irq() saw the frame tud_sof_cb() is for
+static bool sof_synced;           // hid_task() is being called once per frame
+
+// Phase error: how long before the start of the frame it goes out in
+// each report was queued. Synced, this is a little under SOF_LEAD_US.
+// Over half a frame means it only just missed the previous frame.
+static volatile struct
+{
+    uint32_t queued_us; // of the report waiting for a frame, 0 if none
+    uint32_t count;
+    uint32_t late;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} sof_stats;
+
+static void sof_stamp(uint32_t now)
+{
+    sof_us = now;
+    if (!sof_stats.queued_us)
+        return;
+    uint32_t lead = now - sof_stats.queued_us;
+    sof_stats.queued_us = 0;
+    if (lead > SOF_FRAME_US / 2)
+        sof_stats.late++;
+    if (!sof_stats.count || lead < sof_stats.min)
+        sof_stats.min = lead;
+    if (!sof_stats.count || lead > sof_stats.max)
+        sof_stats.max = lead;
+    sof_stats.sum += lead;
+    sof_stats.count++;
+}
+
+// Only sees SOF when it runs ahead of TinyUSB's handler, which clears
+// it by reading sof_rd. Handlers sharing an order priority run in no
+// particular order, so tud_sof_cb() stamps any frame this missed.
+static void sof_irq(void)
+{
+    if (!(usb_hw->ints & USB_INTS_DEV_SOF_BITS))
+        return;
+    sof_stamp(time_us_32());
+    sof_stamped = true;
+}
+
+static void sof_init(void)
+{
+    if (!sof_sync)
+        return;
+    tud_sof_cb_enable(true);
+    irq_add_shared_handler(USBCTRL_IRQ, sof_irq, PICO_SHARED_IRQ_HANDLER_HIGHEST_ORDER_PRIORITY);
+}
+
+// Runs from tud_task(), so a stamp taken here is late by however long
+// the main loop took to get to it. Log the phase error every 1000 reports.
+void tud_sof_cb(uint32_t frame_count)
+{
+    (void)frame_count;
+    uint32_t status = save_and_disable_interrupts();
+    if (!sof_stamped)
+    {
+        sof_stamp(time_us_32());
+        kb_health.sof_misses++;
+    }
+    sof_stamped = false;
+    restore_interrupts(status);
+    if (sof_stats.count < 1000)
+        return;
+    status = save_and_disable_interrupts();
+    uint32_t min = sof_stats.min, max = sof_stats.max;
+    uint32_t avg = sof_stats.sum / sof_stats.count;
+    uint32_t late = sof_stats.late;
+    sof_stats.count = sof_stats.late = 0;
+    sof_stats.sum = 0;
+    restore_interrupts(status);
+    TRACELOG(TRACELOG_SOF, sof_synced, min, avg, max, late);
+}
+
+// Called after every kb_task() with the time it was entered.
+// Returns true when hid_task() should run, which is straight after
+// the phased scan when synced, so reports are built once per frame.
+static bool sof_task(absolute_time_t scanned)
+{
+    static uint32_t synced_sof;
+    static absolute_time_t scan_at;
+    uint32_t sof = sof_us;
+    uint32_t now = time_us_32();
+
+    // Free-run until mounted, and whenever frames stop.
+    sof_synced = sof_sync && tud_mounted() && now - sof < 2 * SOF_FRAME_US;
+    if (!sof_synced)
+    {
+        scan_at = nil_time;
+        return true;
+    }
+
+    // A new frame, phase the scan for the end of it. If we got here
+    // too late for that, this frame's report is left to the next one.
+    if (sof != synced_sof)
+    {
+        synced_sof = sof;
+        scan_at = nil_time;
+        if (now - sof < SOF_FRAME_US - SOF_LEAD_US)
+        {
+            scan_at = delayed_by_us(get_absolute_time(),
+                                    SOF_FRAME_US - SOF_LEAD_US - (now - sof));
+            kb_sync(scan_at);
+        }
+        return false;
+    }
+
+    // kb_task() was entered at or after scan_at, so it just scanned.
+    if (!is_nil_time(scan_at) && absolute_time_diff_us(scan_at, scanned) >= 0)
+    {
+        scan_at = nil_time;
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// Trace log
+//--------------------------------------------------------------------+
+
+// The UART carries nothing but the binary trace log, sent by DMA so
+// logging never waits. There's no stdio on it, as a printf would land
+// in the middle of the stream.
+#define TRACELOG_TX_PIN 16
+#define TRACELOG_RX_PIN 17
+static int tracelog_dma;
+static uint tracelog_sending;
+
+static void tracelog_init(void)
+{
+    uart_init(uart0, 115200);
+    gpio_set_function(TRACELOG_TX_PIN, GPIO_FUNC_UART);
+    gpio_set_function(TRACELOG_RX_PIN, GPIO_FUNC_UART);
+    tracelog_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(tracelog_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, uart_get_dreq(uart0, true));
+    dma_channel_configure(tracelog_dma, &c, &uart_get_hw(uart0)->dr, NULL, 0, false);
+}
+
+static void tracelog_task(void)
+{
+    if (dma_channel_is_busy(tracelog_dma))
+        return;
+    tracelog_consume(tracelog_sending);
+    const uint8_t *data;
+    tracelog_sending = tracelog_peek(&data);
+    if (tracelog_sending)
+        dma_channel_transfer_from_buffer_now(tracelog_dma, data, tracelog_sending);
+}
+
+// The UART runs from clk_peri, which suspend moves to the USB PLL
+// until resume puts it back. Whatever hadn't gone out yet goes after.
+static void tracelog_pause(void)
+{
+    dma_channel_abort(tracelog_dma);
+    tracelog_consume(tracelog_sending - dma_channel_hw_addr(tracelog_dma)->transfer_count);
+    tracelog_sending = 0;
+    uart_tx_wait_blocking(uart0);
+}
+
+//--------------------------------------------------------------------+
+// Parameters
+//--------------------------------------------------------------------+
+
+// Saved in the last sector. Anything there that isn't a good block
+// of this version, like erased flash, leaves the defaults.
+#define PARAMS_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+static bool params_save_pending;
+
+static void params_load(void)
+{
+    struct params p;
+    memcpy(&p, (const void *)(XIP_BASE + PARAMS_FLASH_OFFSET), sizeof(p));
+    params_apply(&p);
+}
+
+// Flash can't be read while it's written, so this runs from the main
+// loop with interrupts off, after the SET_REPORT has been answered.
+// The erase takes tens of milliseconds, which the host sees as NAKs.
+static void params_task(void)
+{
+    if (!params_save_pending)
+        return;
+    params_save_pending = false;
+    uint8_t page[FLASH_PAGE_SIZE] = {0};
+    memcpy(page, &kb_params, sizeof(kb_params));
+    uint32_t status = save_and_disable_interrupts();
+    flash_range_erase(PARAMS_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(PARAMS_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(status);
+}
+
+//--------------------------------------------------------------------+
+// Device callbacks
+//--------------------------------------------------------------------+
+
+// Invoked when device is mounted
+void tud_mount_cb(void)
+{
+    if (!boot_us.mounted)
+        boot_us.mounted = time_us_32();
+}
+
+// Invoked when usb bus is resumed
+void tud_resume_cb(void)
+{
+    wake_us.resumed = time_us_32();
+    if (wake_us.edge)
+        TRACELOG(TRACELOG_WAKE, wake_us.accepted,
+                 wake_us.signalled - wake_us.edge,
+                 wake_us.resumed - wake_us.edge);
+    wake_us.edge = 0;
+}
+
+#ifndef CBM_PS2
+static void boot_report(void)
+{
+    TRACELOG(TRACELOG_BOOT, boot_us.main,
+             boot_us.kb_init - boot_us.main,
+             boot_us.first_scan - boot_us.kb_init,
+             boot_us.usb_init - boot_us.first_scan,
+             boot_us.mounted,
+             boot_us.first_report - boot_us.mounted);
+}
+#endif
+
 //--------------------------------------------------------------------+
 // USB HID
 //--------------------------------------------------------------------+
 
-// Every 8ms, we will sent 1 report for each HID profile (keyboard, mouse etc ..)
+// All keyboard reports go through here so captures see them.
+static void keyboard_report(uint8_t modifier, uint8_t keycode[6])
+{
+#ifdef CBM_PS2
+    // Only changes go out over PS/2.
+    if (!ps2_report(modifier, keycode))
+        return;
+#endif
+    capture(CAPTURE_REPORT, 0, modifier | keycode[0] << 8);
+    capture(CAPTURE_REPORT, 1, keycode[1] | keycode[2] << 8);
+    capture(CAPTURE_REPORT, 2, keycode[3] | keycode[4] << 8);
+    capture(CAPTURE_REPORT, 3, keycode[5]);
+    TRACELOG(TRACELOG_REPORT, modifier, keycode[0], keycode[1],
+             keycode[2], keycode[3], keycode[4], keycode[5]);
+#ifndef CBM_PS2
+    if (!sof_stats.queued_us)
+        sof_stats.queued_us = time_us_32();
+    tud_hid_n_keyboard_report(ITF_NUM_KEYBOARD, 0, modifier, keycode);
+#endif
+}
+
+// Every report_ms (8ms unless tuned), we will sent 1 report for each HID profile (keyboard, mouse etc ..)
 // tud_hid_report_complete_cb() is used to send the next report after previous one is complete
+// With PS/2 the keyboard goes out from ps2_hid_task() instead.
 void hid_task(void)
 {
-    // Poll every 10ms
-    const uint32_t interval_ms = 8;
+#ifndef CBM_PS2
+    const uint32_t interval_ms = kb_params.report_ms;
+    // Synced calls come once per frame, so allow for a little jitter.
+    const uint32_t interval_us = interval_ms * 1000 - (sof_synced ? SOF_FRAME_US / 2 : 0);
     static absolute_time_t start_us = {0};
 
     absolute_time_t now = get_absolute_time();
     if (absolute_time_diff_us(now, start_us) > 0)
         return;
-    start_us = delayed_by_us(now, interval_ms * 1000);
 
-    uint8_t report_id = 0;
     uint8_t keycode[6] = {0};
 
     if (tud_suspended())
     {
         // Wake up host if we are in suspend mode
         // and REMOTE_WAKEUP feature is enabled by host
+        start_us = delayed_by_us(now, interval_us);
         uint8_t modifier = kb_report(keycode);
+        wake_report_put(modifier, keycode);
         if (modifier || keycode[0])
             tud_remote_wakeup();
     }
     else if (tud_hid_n_ready(ITF_NUM_KEYBOARD))
     {
+        // The interval only starts once a report goes out. While
+        // enumerating we keep checking so the first report is sent
+        // the moment the host configures the endpoint.
+        if (!is_nil_time(start_us) && absolute_time_diff_us(start_us, now) >= interval_us)
+            kb_health.report_misses++;
+        start_us = delayed_by_us(now, interval_us);
+        uint8_t modifier;
+        if (!wake_report_get(&modifier, keycode))
+            modifier = kb_report(keycode);
+        keyboard_report(modifier, keycode);
+        if (!boot_us.first_report)
+        {
+            boot_us.first_report = time_us_32();
+            boot_report();
+        }
+    }
+#endif
+}
+
+// PS/2 has no polling to wait for, so a report is built on every pass
+// and whatever changed goes out as make and break codes straight away.
+// Reports that had to be sequenced, like SHIFT changes, follow on the
+// next pass. While the host is behind, keys wait in the scanner.
+static void ps2_hid_task(void)
+{
+#ifdef CBM_PS2
+    ps2_task();
+    if (ps2_ready())
+    {
+        uint8_t keycode[6] = {0};
         uint8_t modifier = kb_report(keycode);
-        tud_hid_n_keyboard_report(ITF_NUM_KEYBOARD, report_id, modifier, keycode);
+        keyboard_report(modifier, keycode);
+    }
+#endif
+}
+
+// The mouse has its own endpoint, polled every 1ms. The PIO does the
+// measuring, so this is a couple of FIFO reads between scans.
+static void mouse_hid_task(void)
+{
+#ifdef CBM_MOUSE
+    if (mouse_task() && !tud_suspended() && tud_hid_n_ready(ITF_NUM_MOUSE))
+    {
+        int8_t x, y;
+        uint8_t buttons = mouse_report(&x, &y);
+        tud_hid_n_mouse_report(ITF_NUM_MOUSE, 0, buttons, x, y, 0, 0);
+    }
+#endif
+}
+
+// Paddles too, the ADC and DMA keep the samples fresh on their own.
+static void paddles_hid_task(void)
+{
+#ifdef CBM_PADDLES
+    // Filtering once per frame is plenty.
+    static absolute_time_t next_us = {0};
+    absolute_time_t now = get_absolute_time();
+    if (absolute_time_diff_us(now, next_us) > 0)
+        return;
+    next_us = delayed_by_us(now, 1000);
+    if (paddles_task() && !tud_suspended() && tud_hid_n_ready(ITF_NUM_PADDLES))
+    {
+        uint8_t report[PADDLE_COUNT + 1];
+        report[PADDLE_COUNT] = paddles_report(report);
+        tud_hid_n_report(ITF_NUM_PADDLES, 0, report, sizeof(report));
+    }
+#endif
+}
+
+// Invoked when a report has been taken by the host.
+// Keys that couldn't share the last report, like + and - which need
+// different SHIFT states, go out on the very next poll. So do the
+// rest of the reports kept while suspended.
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+{
+    (void)report;
+    (void)len;
+
+    if (instance != ITF_NUM_KEYBOARD)
+        return;
+    uint8_t keycode[6] = {0};
+    uint8_t modifier;
+    if (wake_report_get(&modifier, keycode))
+        keyboard_report(modifier, keycode);
+    else if (kb_report_pending())
+    {
+        modifier = kb_report(keycode);
+        keyboard_report(modifier, keycode);
     }
 }
 
@@ -99,13 +674,18 @@ void hid_task(void)
 // Return zero will cause the stack to STALL request
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t *buffer, uint16_t reqlen)
 {
-    // TODO not Implemented
-    (void)instance;
-    (void)report_id;
-    (void)report_type;
-    (void)buffer;
-    (void)reqlen;
+    if (instance != ITF_NUM_DEBUG || report_type != HID_REPORT_TYPE_FEATURE)
+        return 0;
 
+    switch (report_id)
+    {
+    case REPORT_ID_CAPTURE:
+        return capture_get_report(buffer, reqlen);
+    case REPORT_ID_PARAMS:
+        return params_get_report(buffer, reqlen);
+    case REPORT_ID_HEALTH:
+        return health_get_report(buffer, reqlen);
+    }
     return 0;
 }
 
@@ -113,7 +693,21 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_t
 // received data on OUT endpoint ( Report ID = 0, Type = 0 )
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const *buffer, uint16_t bufsize)
 {
-    (void)report_id;
+    // debug interface
+    if (instance == ITF_NUM_DEBUG && report_type == HID_REPORT_TYPE_FEATURE)
+    {
+        switch (report_id)
+        {
+        case REPORT_ID_CAPTURE:
+            capture_set_report(buffer, bufsize);
+            break;
+        case REPORT_ID_PARAMS:
+            if (params_set_report(buffer, bufsize))
+                params_save_pending = true;
+            break;
+        }
+        return;
+    }
 
     // keyboard interface
     if (instance == ITF_NUM_KEYBOARD)
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "mouse.h"
+#include "params.h"
+#include "tusb.h"
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "mouse.pio.h"
+
+#define MOUSE_WINDOW_US 255
+
+static PIO mouse_pio = pio0;
+static uint mouse_sm[2];
+static const uint mouse_pot_pin[2] = {MOUSE_POTX_PIN, MOUSE_POTY_PIN};
+
+static struct
+{
+    bool synced;  // have a position to measure from
+    uint8_t last; // 7 bit position, bit 0 is noise
+    int sum;      // movement since the last report
+} mouse_axis[2];
+
+static uint8_t mouse_buttons;
+static uint32_t mouse_button_us[2]; // last change, left and right
+static uint8_t mouse_sent_buttons;
+
+void mouse_init(void)
+{
+    uint offset = pio_add_program(mouse_pio, &mouse_pot_program);
+    float div = (float)clock_get_hz(clk_sys) / 2000000;
+    for (uint axis = 0; axis < 2; axis++)
+    {
+        uint pin = mouse_pot_pin[axis];
+        uint sm = mouse_sm[axis] = pio_claim_unused_sm(mouse_pio, true);
+        // Held low between the release and the mouse driving it high.
+        pio_gpio_init(mouse_pio, pin);
+        gpio_pull_down(pin);
+        pio_sm_config c = mouse_pot_program_get_default_config(offset);
+        sm_config_set_set_pins(&c, pin, 1);
+        sm_config_set_jmp_pin(&c, pin);
+        sm_config_set_clkdiv(&c, div);
+        pio_sm_set_pins_with_mask(mouse_pio, sm, 0, 1u << pin);
+        pio_sm_set_consecutive_pindirs(mouse_pio, sm, pin, 1, false);
+        pio_sm_init(mouse_pio, sm, offset, &c);
+        pio_sm_put(mouse_pio, sm, MOUSE_WINDOW_US);
+        pio_sm_set_enabled(mouse_pio, sm, true);
+    }
+
+    gpio_init(MOUSE_LEFT_PIN);
+    gpio_set_dir(MOUSE_LEFT_PIN, GPIO_IN);
+    gpio_pull_up(MOUSE_LEFT_PIN);
+    gpio_init(MOUSE_RIGHT_PIN);
+    gpio_set_dir(MOUSE_RIGHT_PIN, GPIO_IN);
+    gpio_pull_up(MOUSE_RIGHT_PIN);
+}
+
+// Same decoding as the 1351 driver on a C64. The change in position
+// is taken modulo 64, and bit 0 is dropped as noise.
+static void mouse_axis_move(uint axis, uint32_t left)
+{
+    if (left > MOUSE_WINDOW_US)
+    {
+        // No mouse, or it's in joystick mode.
+        mouse_axis[axis].synced = false;
+        return;
+    }
+    uint8_t pos = (MOUSE_WINDOW_US - left) & 0x7F;
+    uint8_t delta = (pos - mouse_axis[axis].last) & 0x7F;
+    if (!mouse_axis[axis].synced)
+    {
+        mouse_axis[axis].synced = true;
+        mouse_axis[axis].last = pos;
+        return;
+    }
+    if (delta >= 0x40)
+        delta |= 0x80;
+    int move = (int8_t)delta >> 1;
+    if (move)
+    {
+        mouse_axis[axis].last = pos;
+        mouse_axis[axis].sum += move;
+    }
+}
+
+// The buttons aren't in the matrix, so they get the same lockout
+// debounce as the keys here: act on the first edge, then ignore the
+// button for debounce_us, so a bouncing fire button is one click.
+static void mouse_button(uint button, uint8_t bit, bool down)
+{
+    uint32_t now = time_us_32();
+    if (down != !!(mouse_buttons & bit) &&
+        now - mouse_button_us[button] >= kb_params.debounce_us)
+    {
+        mouse_buttons ^= bit;
+        mouse_button_us[button] = now;
+    }
+}
+
+bool mouse_task(void)
+{
+    for (uint axis = 0; axis < 2; axis++)
+        while (!pio_sm_is_rx_fifo_empty(mouse_pio, mouse_sm[axis]))
+            mouse_axis_move(axis, pio_sm_get(mouse_pio, mouse_sm[axis]));
+
+    uint32_t gpio = gpio_get_all();
+    mouse_button(0, MOUSE_BUTTON_LEFT, !(gpio & (1u << MOUSE_LEFT_PIN)));
+    mouse_button(1, MOUSE_BUTTON_RIGHT, !(gpio & (1u << MOUSE_RIGHT_PIN)));
+
+    return mouse_axis[0].sum || mouse_axis[1].sum ||
+           mouse_buttons != mouse_sent_buttons;
+}
+
+static int8_t mouse_take(uint axis)
+{
+    int move = mouse_axis[axis].sum;
+    if (move > 127)
+        move = 127;
+    if (move < -127)
+        move = -127;
+    mouse_axis[axis].sum -= move;
+    return move;
+}
+
+uint8_t mouse_report(int8_t *x, int8_t *y)
+{
+    *x = mouse_take(0);
+    // The 1351 counts up moving away from you, HID counts down.
+    *y = -mouse_take(1);
+    mouse_sent_buttons = mouse_buttons;
+    return mouse_buttons;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _MOUSE_H
+#define _MOUSE_H
+
+// Commodore 1351 mouse in proportional mode. The mouse watches the
+// SID discharge its POT lines, then pulls each line high after a delay
+// that encodes the position, modulo 64, in bits 1-6. Two PIO state
+// machines run the SID measurement cycle so the scan loop only reads
+// the results. Left button is control port fire, right is up.
+
+#include "pico/stdlib.h"
+
+#define MOUSE_POTX_PIN 27
+#define MOUSE_POTY_PIN 28
+#define MOUSE_LEFT_PIN 26
+#define MOUSE_RIGHT_PIN 22
+
+void mouse_init(void);
+
+// Drains the measurements and reads the buttons. Returns true
+// when there is movement or a button change to report.
+bool mouse_task(void);
+
+// Movement since the last report, HID direction, and the buttons.
+uint8_t mouse_report(int8_t *x, int8_t *y);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "paddles.h"
+#include "params.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include <stdlib.h>
+
+// 20k samples/s shared by the channels. The ring holds the last 16
+// samples, 800us, which is 8 of each paddle spread over the whole
+// 800us. Averaging them is the whole of the smoothing.
+#define PADDLE_SAMPLE_HZ 20000
+#define PADDLE_RING 16
+#define PADDLE_RING_BITS 5 // ring size in bytes, as a power of 2
+static_assert(PADDLE_RING * sizeof(uint16_t) == 1u << PADDLE_RING_BITS);
+static_assert(PADDLE_RING % PADDLE_COUNT == 0);
+
+static uint16_t paddle_ring[PADDLE_RING]
+    __attribute__((aligned(PADDLE_RING * sizeof(uint16_t))));
+static int paddle_dma;
+
+static uint16_t paddle_pos16[PADDLE_COUNT]; // 1/16ths, for hysteresis
+static uint8_t paddle_pos[PADDLE_COUNT];
+static uint8_t paddle_buttons;
+static uint32_t paddle_button_us[PADDLE_COUNT]; // last change
+static uint8_t paddle_sent_pos[PADDLE_COUNT];
+static uint8_t paddle_sent_buttons;
+
+// Restarts line the ring back up with the round robin.
+static void paddles_start(void)
+{
+    adc_run(false);
+    adc_fifo_drain();
+    adc_select_input(PADDLE_PIN(0) - 26);
+    dma_channel_set_write_addr(paddle_dma, paddle_ring, false);
+    dma_channel_set_trans_count(paddle_dma, UINT32_MAX, true);
+    adc_run(true);
+}
+
+void paddles_init(void)
+{
+    adc_init();
+    for (uint paddle = 0; paddle < PADDLE_COUNT; paddle++)
+    {
+        adc_gpio_init(PADDLE_PIN(paddle));
+        gpio_init(PADDLE_BUTTON_PIN(paddle));
+        gpio_set_dir(PADDLE_BUTTON_PIN(paddle), GPIO_IN);
+        gpio_pull_up(PADDLE_BUTTON_PIN(paddle));
+    }
+    adc_set_round_robin((1u << PADDLE_COUNT) - 1);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv(48000000 / PADDLE_SAMPLE_HZ - 1);
+
+    // The write address wraps around the ring, in step with the
+    // round robin, so paddle_ring[i] is always paddle i % PADDLE_COUNT.
+    paddle_dma = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(paddle_dma);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, PADDLE_RING_BITS);
+    channel_config_set_dreq(&c, DREQ_ADC);
+    dma_channel_configure(paddle_dma, &c, paddle_ring, &adc_hw->fifo, 0, false);
+    paddles_start();
+}
+
+// The pot and the resistor to ground are a divider, so undo it
+// to get back to a reading proportional to the pot, like the SID's.
+static uint paddle_linear16(uint sum, uint samples)
+{
+    if (!sum)
+        return 255 * 16;
+    uint64_t pos16 = (uint64_t)PADDLE_R_KOHM * 255 * 16 *
+                     (4095 * samples - sum) / ((uint64_t)PADDLE_POT_KOHM * sum);
+    return pos16 > 255 * 16 ? 255 * 16 : pos16;
+}
+
+bool paddles_task(void)
+{
+    // The transfer count runs out after a couple of days.
+    if (!dma_channel_is_busy(paddle_dma))
+        paddles_start();
+
+    // DMA carries on writing while this reads, so the sum can take a
+    // sample or two from the period before. Each is still a whole
+    // sample of the right paddle, so that's only a slightly older window.
+    uint sum[PADDLE_COUNT] = {0};
+    for (uint i = 0; i < PADDLE_RING; i++)
+        sum[i % PADDLE_COUNT] += paddle_ring[i];
+
+    // Moves of under 3/4 of a step are noise, not the player.
+    for (uint paddle = 0; paddle < PADDLE_COUNT; paddle++)
+    {
+        uint pos16 = paddle_linear16(sum[paddle], PADDLE_RING / PADDLE_COUNT);
+        if (abs((int)pos16 - paddle_pos16[paddle]) > 12)
+        {
+            paddle_pos16[paddle] = pos16;
+            paddle_pos[paddle] = (pos16 + 8) / 16 > 255 ? 255 : (pos16 + 8) / 16;
+        }
+    }
+
+    // The buttons aren't in the matrix, so they get the same lockout
+    // debounce as the keys here: act on the first edge, then ignore
+    // the button for debounce_us.
+    uint32_t gpio = gpio_get_all();
+    uint32_t now = time_us_32();
+    for (uint paddle = 0; paddle < PADDLE_COUNT; paddle++)
+    {
+        uint8_t bit = 1u << paddle;
+        bool down = !(gpio & (1u << PADDLE_BUTTON_PIN(paddle)));
+        if (down != !!(paddle_buttons & bit) &&
+            now - paddle_button_us[paddle] >= kb_params.debounce_us)
+        {
+            paddle_buttons ^= bit;
+            paddle_button_us[paddle] = now;
+        }
+    }
+
+    for (uint paddle = 0; paddle < PADDLE_COUNT; paddle++)
+        if (paddle_pos[paddle] != paddle_sent_pos[paddle])
+            return true;
+    return paddle_buttons != paddle_sent_buttons;
+}
+
+uint8_t paddles_report(uint8_t pos[PADDLE_COUNT])
+{
+    for (uint paddle = 0; paddle < PADDLE_COUNT; paddle++)
+        pos[paddle] = paddle_sent_pos[paddle] = paddle_pos[paddle];
+    paddle_sent_buttons = paddle_buttons;
+    return paddle_buttons;
+}
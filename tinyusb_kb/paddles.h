@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PADDLES_H
+#define _PADDLES_H
+
+// A pair of original paddles on the ADC. Each 470k pot goes from 3.3V
+// to its ADC pin, which has a fixed resistor to ground. The ADC free
+// runs round robin over both channels and DMA keeps a ring of the
+// latest samples, so reading the paddles costs no time in the scan.
+
+#include "pico/stdlib.h"
+
+#define PADDLE_COUNT 2
+#define PADDLE_PIN(paddle) (26 + (paddle))      // ADC0 and ADC1
+#define PADDLE_BUTTON_PIN(paddle) (21 + (paddle)) // control port LEFT, RIGHT
+#define PADDLE_POT_KOHM 470
+#define PADDLE_R_KOHM 100 // to ground from each ADC pin
+
+void paddles_init(void);
+
+// Filters the latest samples and reads the buttons. Returns true
+// when anything changed since the last report.
+bool paddles_task(void);
+
+// Positions 0-255, like the SID reads them, and the buttons.
+uint8_t paddles_report(uint8_t pos[PADDLE_COUNT]);
+
+#endif
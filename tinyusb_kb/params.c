@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "params.h"
+#include <string.h>
+
+static_assert(sizeof(struct params) <= PARAMS_REPORT_LEN);
+
+static const struct params params_defaults = {
+    .version = PARAMS_VERSION,
+    .cas_us = 6,
+    .scan_interval_us = 200,
+    .ghost_us = 2000,
+    .debounce_us = 20000,
+    .wake_expire_ms = 2000,
+    .report_ms = 8,
+    .mister = false,
+    .acquire = PARAMS_ACQUIRE_STROBE,
+    .debounce = PARAMS_DEBOUNCE_LOCKOUT,
+    .ghost = PARAMS_GHOST_HOLD,
+    .report = PARAMS_REPORT_NEXT_POLL,
+};
+
+struct params kb_params = params_defaults;
+volatile uint32_t params_generation;
+
+bool params_apply(const struct params *p)
+{
+    if (p->version != PARAMS_VERSION ||
+        p->cas_us < 1 || p->cas_us > 100 ||
+        p->scan_interval_us < 16 * p->cas_us || // room for 16 strobes
+        p->scan_interval_us > 10000 ||
+        p->debounce_us <= p->ghost_us ||
+        p->report_ms < 1 || p->mister > 1 ||
+        (p->wake_expire_ms && p->wake_expire_ms < p->report_ms) ||
+        p->acquire >= PARAMS_ACQUIRES ||
+        p->debounce >= PARAMS_DEBOUNCES ||
+        p->ghost >= PARAMS_GHOSTS ||
+        p->report >= PARAMS_REPORTS)
+        return false;
+    kb_params = *p;
+    params_generation++;
+    return true;
+}
+
+bool params_set_report(uint8_t const *buffer, uint16_t bufsize)
+{
+    if (bufsize < 1)
+        return false;
+    switch (buffer[0])
+    {
+    case PARAMS_CMD_SET:
+        if (bufsize >= 1 + sizeof(struct params))
+        {
+            struct params p;
+            memcpy(&p, &buffer[1], sizeof(p));
+            params_apply(&p);
+        }
+        break;
+    case PARAMS_CMD_SAVE:
+        return true;
+    case PARAMS_CMD_DEFAULTS:
+        params_apply(&params_defaults);
+        break;
+    }
+    return false;
+}
+
+uint16_t params_get_report(uint8_t *buffer, uint16_t reqlen)
+{
+    if (reqlen < PARAMS_REPORT_LEN)
+        return 0;
+    memset(buffer, 0, PARAMS_REPORT_LEN);
+    memcpy(buffer, &kb_params, sizeof(kb_params));
+    return PARAMS_REPORT_LEN;
+}
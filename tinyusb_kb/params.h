@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PARAMS_H
+#define _PARAMS_H
+
+// Scan and report timing, and the kb6 pipeline strategies, that can
+// be tuned without reflashing. The block is read and written as report
+// ID 2 feature reports on the debug interface, and saved in the last
+// sector of flash.
+
+#include "pico/stdlib.h"
+
+#define PARAMS_VERSION 3
+
+// Little endian, also the report and flash layout. Bump the version
+// for any change, saved blocks of other versions are ignored.
+struct params
+{
+    uint16_t version;
+    uint16_t cas_us;           // column strobe to row read
+    uint16_t scan_interval_us; // start to start
+    uint16_t ghost_us;         // safety wait for bouncing ghost keys
+    uint16_t debounce_us;      // keys are sticky for this long
+    uint16_t wake_expire_ms;   // drop reports kept in suspend once this old, 0 never
+    uint8_t report_ms;         // keyboard report interval
+    uint8_t mister;            // start in MiSTer mode
+    uint8_t acquire;           // matrix read strategy
+    uint8_t debounce;          // debounce strategy
+    uint8_t ghost;             // ghost resolver
+    uint8_t report;            // report sequencing
+};
+
+// Strategies for each stage of the src/kb6.c pipeline
+#define PARAMS_ACQUIRE_STROBE 0 // one column at a time
+#define PARAMS_ACQUIRE_PROBE 1  // all columns first, strobe if a row is low
+#define PARAMS_ACQUIRES 2
+#define PARAMS_DEBOUNCE_LOCKOUT 0 // act on the first edge, then ignore
+#define PARAMS_DEBOUNCE_STEADY 1  // act once the contacts agree
+#define PARAMS_DEBOUNCES 2
+#define PARAMS_GHOST_HOLD 0     // hold keys that could be ghosts
+#define PARAMS_GHOST_NONE 1     // believe the matrix
+#define PARAMS_GHOST_TEMPORAL 2 // hold only keys that came after theirs
+#define PARAMS_GHOSTS 3
+#define PARAMS_REPORT_NEXT_POLL 0 // held back keys go on the next poll
+#define PARAMS_REPORT_INTERVAL 1  // or wait for the next report interval
+#define PARAMS_REPORTS 2
+
+extern struct params kb_params;
+
+// Bumped whenever kb_params changes, so users can recompute.
+extern volatile uint32_t params_generation;
+
+// Checks the block, and if it's good makes it current.
+bool params_apply(const struct params *p);
+
+// SET takes a command byte then, for SET, the block.
+// GET returns the current block.
+#define PARAMS_CMD_SET 0
+#define PARAMS_CMD_SAVE 1
+#define PARAMS_CMD_DEFAULTS 2
+#define PARAMS_REPORT_LEN 63
+
+// Returns true when the block should be saved to flash.
+bool params_set_report(uint8_t const *buffer, uint16_t bufsize);
+uint16_t params_get_report(uint8_t *buffer, uint16_t reqlen);
+
+#endif
@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "ps2.h"
+#include "tusb.h"
+#include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "ps2.pio.h"
+#include <string.h>
+
+// Bytes queued for the host. The indexes wrap with the byte.
+#define PS2_QUEUE_SIZE 256
+// A report can break and make 6 keys and 8 modifiers, 3 bytes apiece.
+#define PS2_REPORT_MAX ((6 + 8) * 2 * 3)
+
+// Codes from the keyboard
+#define PS2_EXTENDED 0xE0
+#define PS2_BREAK 0xF0
+#define PS2_BAT_OK 0xAA
+#define PS2_ECHO 0xEE
+#define PS2_ACK 0xFA
+#define PS2_RESEND 0xFE
+
+// Commands from the host, the first three take an argument.
+#define PS2_CMD_LEDS 0xED
+#define PS2_CMD_ECHO 0xEE
+#define PS2_CMD_SCAN_SET 0xF0
+#define PS2_CMD_ID 0xF2
+#define PS2_CMD_TYPEMATIC 0xF3
+#define PS2_CMD_ENABLE 0xF4
+#define PS2_CMD_DISABLE 0xF5
+#define PS2_CMD_DEFAULTS 0xF6
+#define PS2_CMD_RESEND 0xFE
+#define PS2_CMD_RESET 0xFF
+
+#define PS2_LED_CAPS 0x04
+#define PS2_TYPEMATIC_DEFAULT 0x2B // 10.9cps after 500ms
+
+// Words from the PIO that aren't received frames.
+#define PS2_RX_SENT 0
+#define PS2_RX_ABORTED 0xFFFFFFFF
+
+// Set 2 codes for each HID usage, PS2_E0 marks the extended keys. Every
+// usage the CBM translators can produce is here, along with the rest
+// of a PC keyboard. Print Screen and Pause have multi-byte sequences
+// of their own and no CBM key makes them, so they are left out.
+#define PS2_E0 0x100
+static const uint16_t ps2_codes[] = {
+    [HID_KEY_A] = 0x1C,
+    [HID_KEY_B] = 0x32,
+    [HID_KEY_C] = 0x21,
+    [HID_KEY_D] = 0x23,
+    [HID_KEY_E] = 0x24,
+    [HID_KEY_F] = 0x2B,
+    [HID_KEY_G] = 0x34,
+    [HID_KEY_H] = 0x33,
+    [HID_KEY_I] = 0x43,
+    [HID_KEY_J] = 0x3B,
+    [HID_KEY_K] = 0x42,
+    [HID_KEY_L] = 0x4B,
+    [HID_KEY_M] = 0x3A,
+    [HID_KEY_N] = 0x31,
+    [HID_KEY_O] = 0x44,
+    [HID_KEY_P] = 0x4D,
+    [HID_KEY_Q] = 0x15,
+    [HID_KEY_R] = 0x2D,
+    [HID_KEY_S] = 0x1B,
+    [HID_KEY_T] = 0x2C,
+    [HID_KEY_U] = 0x3C,
+    [HID_KEY_V] = 0x2A,
+    [HID_KEY_W] = 0x1D,
+    [HID_KEY_X] = 0x22,
+    [HID_KEY_Y] = 0x35,
+    [HID_KEY_Z] = 0x1A,
+    [HID_KEY_1] = 0x16,
+    [HID_KEY_2] = 0x1E,
+    [HID_KEY_3] = 0x26,
+    [HID_KEY_4] = 0x25,
+    [HID_KEY_5] = 0x2E,
+    [HID_KEY_6] = 0x36,
+    [HID_KEY_7] = 0x3D,
+    [HID_KEY_8] = 0x3E,
+    [HID_KEY_9] = 0x46,
+    [HID_KEY_0] = 0x45,
+    [HID_KEY_ENTER] = 0x5A,
+    [HID_KEY_ESCAPE] = 0x76,
+    [HID_KEY_BACKSPACE] = 0x66,
+    [HID_KEY_TAB] = 0x0D,
+    [HID_KEY_SPACE] = 0x29,
+    [HID_KEY_MINUS] = 0x4E,
+    [HID_KEY_EQUAL] = 0x55,
+    [HID_KEY_BRACKET_LEFT] = 0x54,
+    [HID_KEY_BRACKET_RIGHT] = 0x5B,
+    [HID_KEY_BACKSLASH] = 0x5D,
+    [HID_KEY_EUROPE_1] = 0x5D,
+    [HID_KEY_SEMICOLON] = 0x4C,
+    [HID_KEY_APOSTROPHE] = 0x52,
+    [HID_KEY_GRAVE] = 0x0E,
+    [HID_KEY_COMMA] = 0x41,
+    [HID_KEY_PERIOD] = 0x49,
+    [HID_KEY_SLASH] = 0x4A,
+    [HID_KEY_CAPS_LOCK] = 0x58,
+    [HID_KEY_F1] = 0x05,
+    [HID_KEY_F2] = 0x06,
+    [HID_KEY_F3] = 0x04,
+    [HID_KEY_F4] = 0x0C,
+    [HID_KEY_F5] = 0x03,
+    [HID_KEY_F6] = 0x0B,
+    [HID_KEY_F7] = 0x83,
+    [HID_KEY_F8] = 0x0A,
+    [HID_KEY_F9] = 0x01,
+    [HID_KEY_F10] = 0x09,
+    [HID_KEY_F11] = 0x78,
+    [HID_KEY_F12] = 0x07,
+    [HID_KEY_SCROLL_LOCK] = 0x7E,
+    [HID_KEY_INSERT] = PS2_E0 | 0x70,
+    [HID_KEY_HOME] = PS2_E0 | 0x6C,
+    [HID_KEY_PAGE_UP] = PS2_E0 | 0x7D,
+    [HID_KEY_DELETE] = PS2_E0 | 0x71,
+    [HID_KEY_END] = PS2_E0 | 0x69,
+    [HID_KEY_PAGE_DOWN] = PS2_E0 | 0x7A,
+    [HID_KEY_ARROW_RIGHT] = PS2_E0 | 0x74,
+    [HID_KEY_ARROW_LEFT] = PS2_E0 | 0x6B,
+    [HID_KEY_ARROW_DOWN] = PS2_E0 | 0x72,
+    [HID_KEY_ARROW_UP] = PS2_E0 | 0x75,
+    [HID_KEY_NUM_LOCK] = 0x77,
+    [HID_KEY_KEYPAD_DIVIDE] = PS2_E0 | 0x4A,
+    [HID_KEY_KEYPAD_MULTIPLY] = 0x7C,
+    [HID_KEY_KEYPAD_SUBTRACT] = 0x7B,
+    [HID_KEY_KEYPAD_ADD] = 0x79,
+    [HID_KEY_KEYPAD_ENTER] = PS2_E0 | 0x5A,
+    [HID_KEY_KEYPAD_1] = 0x69,
+    [HID_KEY_KEYPAD_2] = 0x72,
+    [HID_KEY_KEYPAD_3] = 0x7A,
+    [HID_KEY_KEYPAD_4] = 0x6B,
+    [HID_KEY_KEYPAD_5] = 0x73,
+    [HID_KEY_KEYPAD_6] = 0x74,
+    [HID_KEY_KEYPAD_7] = 0x6C,
+    [HID_KEY_KEYPAD_8] = 0x75,
+    [HID_KEY_KEYPAD_9] = 0x7D,
+    [HID_KEY_KEYPAD_0] = 0x70,
+    [HID_KEY_KEYPAD_DECIMAL] = 0x71,
+    [HID_KEY_EUROPE_2] = 0x61,
+    [HID_KEY_APPLICATION] = PS2_E0 | 0x2F,
+};
+
+// Modifier bits in HID report order.
+static const uint16_t ps2_modifier_codes[8] = {
+    0x14,          // left ctrl
+    0x12,          // left shift
+    0x11,          // left alt
+    PS2_E0 | 0x1F, // left gui
+    PS2_E0 | 0x14, // right ctrl
+    0x59,          // right shift
+    PS2_E0 | 0x11, // right alt
+    PS2_E0 | 0x27, // right gui
+};
+
+static PIO ps2_pio = pio0;
+static uint ps2_sm;
+
+static uint8_t ps2_queue[PS2_QUEUE_SIZE];
+static uint8_t ps2_head;
+static uint8_t ps2_tail;
+
+// The byte being sent goes back to the PIO until it's all the way out.
+static int ps2_sending = -1;
+static bool ps2_in_pio;
+static uint8_t ps2_sent; // for the host's resend
+
+static uint8_t ps2_argument_for; // command waiting for its argument
+static bool ps2_enabled = true;
+
+// What the host has been told is held.
+static uint8_t ps2_modifier;
+static uint8_t ps2_keycode[6];
+
+// Typematic repeat of the last key made.
+static uint8_t ps2_repeat;
+static absolute_time_t ps2_repeat_at;
+static uint32_t ps2_delay_us;
+static uint32_t ps2_period_us;
+
+static void ps2_put(uint8_t data)
+{
+    ps2_queue[ps2_head++] = data;
+}
+
+static void ps2_code(uint16_t code, bool make)
+{
+    if (code & PS2_E0)
+        ps2_put(PS2_EXTENDED);
+    if (!make)
+        ps2_put(PS2_BREAK);
+    ps2_put(code);
+}
+
+static void ps2_key(uint8_t keycode, bool make)
+{
+    if (keycode >= sizeof(ps2_codes) / sizeof(ps2_codes[0]) || !ps2_codes[keycode])
+        return;
+    ps2_code(ps2_codes[keycode], make);
+    if (make)
+    {
+        ps2_repeat = keycode;
+        ps2_repeat_at = make_timeout_time_us(ps2_delay_us);
+    }
+    else if (keycode == ps2_repeat)
+        ps2_repeat = 0;
+}
+
+static void ps2_typematic(uint8_t rate)
+{
+    ps2_delay_us = ((rate >> 5 & 3) + 1) * 250000;
+    // (8 + A) * 2^B * 4.17ms, from 30 down to 2 a second.
+    ps2_period_us = (8 + (rate & 7)) * (1u << (rate >> 3 & 3)) * 4170;
+}
+
+static void ps2_flush(void)
+{
+    ps2_tail = ps2_head;
+    if (!ps2_in_pio)
+        ps2_sending = -1;
+}
+
+static void ps2_defaults(void)
+{
+    ps2_typematic(PS2_TYPEMATIC_DEFAULT);
+    ps2_repeat = 0;
+    ps2_flush();
+}
+
+// Replies queue behind any key codes already waiting,
+// so a code is never split.
+static void ps2_command(uint8_t data)
+{
+    // Anything from the command range starts a new command.
+    uint8_t command = ps2_argument_for;
+    ps2_argument_for = 0;
+    if (command && data < PS2_CMD_LEDS)
+    {
+        ps2_put(PS2_ACK);
+        switch (command)
+        {
+        case PS2_CMD_LEDS:
+            gpio_put(PICO_DEFAULT_LED_PIN, data & PS2_LED_CAPS);
+            break;
+        case PS2_CMD_TYPEMATIC:
+            ps2_typematic(data);
+            break;
+        case PS2_CMD_SCAN_SET:
+            // Only set 2, but 0 asks which is in use.
+            if (!data)
+                ps2_put(2);
+            break;
+        }
+        return;
+    }
+
+    switch (data)
+    {
+    case PS2_CMD_LEDS:
+    case PS2_CMD_SCAN_SET:
+    case PS2_CMD_TYPEMATIC:
+        ps2_argument_for = data;
+        ps2_put(PS2_ACK);
+        break;
+    case PS2_CMD_ECHO:
+        ps2_put(PS2_ECHO);
+        break;
+    case PS2_CMD_ID:
+        ps2_put(PS2_ACK);
+        ps2_put(0xAB);
+        ps2_put(0x83);
+        break;
+    case PS2_CMD_ENABLE:
+        ps2_flush();
+        ps2_enabled = true;
+        ps2_put(PS2_ACK);
+        break;
+    case PS2_CMD_DISABLE:
+        ps2_defaults();
+        ps2_enabled = false;
+        ps2_put(PS2_ACK);
+        break;
+    case PS2_CMD_DEFAULTS:
+        ps2_defaults();
+        ps2_put(PS2_ACK);
+        break;
+    case PS2_CMD_RESEND:
+        if (ps2_sending < 0)
+            ps2_sending = ps2_sent;
+        break;
+    case PS2_CMD_RESET:
+        // Held keys are made again once the host has had the BAT code.
+        ps2_defaults();
+        ps2_enabled = true;
+        ps2_modifier = 0;
+        memset(ps2_keycode, 0, sizeof(ps2_keycode));
+        gpio_put(PICO_DEFAULT_LED_PIN, false);
+        ps2_put(PS2_ACK);
+        ps2_put(PS2_BAT_OK);
+        break;
+    default:
+        // Set 3 key types have nothing to do in set 2.
+        ps2_put(data > PS2_CMD_DEFAULTS ? PS2_ACK : PS2_RESEND);
+        break;
+    }
+}
+
+static void ps2_receive(uint32_t frame)
+{
+    frame >>= 22;
+    uint8_t data = frame;
+    bool parity = frame & 0x100;
+    bool stop = frame & 0x200;
+    if (!stop || parity == (__builtin_popcount(data) & 1))
+    {
+        ps2_put(PS2_RESEND);
+        return;
+    }
+    ps2_command(data);
+}
+
+void ps2_init(void)
+{
+    ps2_typematic(PS2_TYPEMATIC_DEFAULT);
+
+    uint offset = pio_add_program(ps2_pio, &ps2_device_program);
+    ps2_sm = pio_claim_unused_sm(ps2_pio, true);
+    uint32_t pins = 1u << PS2_DATA_PIN | 1u << PS2_CLOCK_PIN;
+    // Pulled up so an unplugged port looks idle, the host's pull-ups win.
+    pio_gpio_init(ps2_pio, PS2_DATA_PIN);
+    pio_gpio_init(ps2_pio, PS2_CLOCK_PIN);
+    gpio_pull_up(PS2_DATA_PIN);
+    gpio_pull_up(PS2_CLOCK_PIN);
+    pio_sm_config c = ps2_device_program_get_default_config(offset);
+    sm_config_set_out_pins(&c, PS2_DATA_PIN, 1);
+    sm_config_set_set_pins(&c, PS2_DATA_PIN, 1);
+    sm_config_set_in_pins(&c, PS2_DATA_PIN);
+    sm_config_set_sideset_pins(&c, PS2_CLOCK_PIN);
+    sm_config_set_jmp_pin(&c, PS2_CLOCK_PIN);
+    sm_config_set_out_shift(&c, true, false, 32);
+    sm_config_set_in_shift(&c, true, false, 32);
+    sm_config_set_mov_status(&c, STATUS_TX_LESSTHAN, 1);
+    sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / 200000);
+    pio_sm_set_pins_with_mask(ps2_pio, ps2_sm, 0, pins);
+    pio_sm_set_pindirs_with_mask(ps2_pio, ps2_sm, 0, pins);
+    pio_sm_init(ps2_pio, ps2_sm, offset, &c);
+    pio_sm_set_enabled(ps2_pio, ps2_sm, true);
+
+    // A keyboard says it passed its self test at power on.
+    ps2_put(PS2_BAT_OK);
+}
+
+void ps2_task(void)
+{
+    while (!pio_sm_is_rx_fifo_empty(ps2_pio, ps2_sm))
+    {
+        uint32_t word = pio_sm_get(ps2_pio, ps2_sm);
+        if (word == PS2_RX_SENT)
+        {
+            ps2_sent = ps2_sending;
+            ps2_sending = -1;
+            ps2_in_pio = false;
+        }
+        else if (word == PS2_RX_ABORTED)
+            ps2_in_pio = false;
+        else
+            ps2_receive(word);
+    }
+
+    if (ps2_repeat && ps2_enabled && ps2_head == ps2_tail &&
+        ps2_sending < 0 && time_reached(ps2_repeat_at))
+    {
+        ps2_code(ps2_codes[ps2_repeat], true);
+        ps2_repeat_at = make_timeout_time_us(ps2_period_us);
+    }
+
+    if (ps2_in_pio)
+        return;
+    if (ps2_sending < 0 && ps2_head != ps2_tail)
+        ps2_sending = ps2_queue[ps2_tail++];
+    if (ps2_sending < 0)
+        return;
+    // Start bit, data, odd parity, stop bit. Inverted for the pin directions.
+    uint32_t data = ps2_sending;
+    uint32_t parity = !(__builtin_popcount(data) & 1);
+    pio_sm_put(ps2_pio, ps2_sm, ~(data << 1 | parity << 9 | 1u << 10));
+    ps2_in_pio = true;
+}
+
+bool ps2_ready(void)
+{
+    return ps2_enabled && (uint8_t)(ps2_head - ps2_tail) < PS2_QUEUE_SIZE - PS2_REPORT_MAX;
+}
+
+static bool ps2_has(const uint8_t keycode[6], uint8_t key)
+{
+    for (uint i = 0; i < 6; i++)
+        if (keycode[i] == key)
+            return true;
+    return false;
+}
+
+bool ps2_report(uint8_t modifier, const uint8_t keycode[6])
+{
+    // Phantom state, PS/2 has no rollover error,
+    // so the host keeps what it had.
+    if (keycode[0] == 1)
+        return false;
+    if (modifier == ps2_modifier && !memcmp(keycode, ps2_keycode, 6))
+        return false;
+
+    // Breaks go first and modifiers are made before keys,
+    // so a key that needs a different SHIFT comes after it.
+    for (uint i = 0; i < 6; i++)
+        if (ps2_keycode[i] && !ps2_has(keycode, ps2_keycode[i]))
+            ps2_key(ps2_keycode[i], false);
+    for (uint bit = 0; bit < 8; bit++)
+        if (ps2_modifier & ~modifier & 1u << bit)
+            ps2_code(ps2_modifier_codes[bit], false);
+    for (uint bit = 0; bit < 8; bit++)
+        if (modifier & ~ps2_modifier & 1u << bit)
+            ps2_code(ps2_modifier_codes[bit], true);
+    for (uint i = 0; i < 6; i++)
+        if (keycode[i] && !ps2_has(ps2_keycode, keycode[i]))
+            ps2_key(keycode[i], true);
+
+    ps2_modifier = modifier;
+    memcpy(ps2_keycode, keycode, 6);
+    return true;
+}
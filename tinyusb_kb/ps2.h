@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _PS2_H
+#define _PS2_H
+
+// PS/2 keyboard for hosts without USB. A PIO state machine runs the
+// bus, the CPU turns each change in the keyboard report into scan code
+// set 2 make and break codes, answers the host's commands and does
+// the typematic repeat. The lines are 5V open collector, so they need
+// a level shifter between the connector and the pins.
+
+#include "pico/stdlib.h"
+
+#define PS2_DATA_PIN 27
+#define PS2_CLOCK_PIN 28 // must be PS2_DATA_PIN + 1
+
+void ps2_init(void);
+
+// Sends and receives over the PIO, answers commands
+// and repeats the held key.
+void ps2_task(void);
+
+// True when the host is taking keys and the
+// queue has room for whatever a report can need.
+bool ps2_ready(void);
+
+// Queues codes for what changed since the last report.
+// Returns false when there was nothing to send.
+bool ps2_report(uint8_t modifier, const uint8_t keycode[6]);
+
+#endif
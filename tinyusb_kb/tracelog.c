@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "tracelog.h"
+
+uint8_t tracelog_buf[TRACELOG_SIZE];
+uint32_t tracelog_head;
+uint32_t tracelog_tail;
+uint32_t tracelog_last_us;
+uint32_t tracelog_dropped;
+
+// Goes in ahead of the first event logged after the ring was full.
+void tracelog_flush_dropped(void)
+{
+    uint32_t head = tracelog_head;
+    tracelog_buf[head++ % TRACELOG_SIZE] = 0x80 | TRACELOG_DROPPED;
+    head = tracelog_varint(head, 0);
+    head = tracelog_varint(head, tracelog_dropped);
+    tracelog_head = head;
+    tracelog_dropped = 0;
+}
+
+uint tracelog_peek(const uint8_t **data)
+{
+    uint32_t tail = tracelog_tail % TRACELOG_SIZE;
+    uint32_t len = tracelog_head - tracelog_tail;
+    *data = &tracelog_buf[tail];
+    return MIN(len, TRACELOG_SIZE - tail);
+}
+
+void tracelog_consume(uint len)
+{
+    tracelog_tail += len;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2022 Rumbledethumps
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _TRACELOG_H
+#define _TRACELOG_H
+
+// Binary trace log, cheap enough to leave on in the scan loop. Events
+// are an ID byte, then the microseconds since the previous event and
+// the arguments as varints, written to a RAM ring that DMA drains to
+// the GP16 UART. host/tracelog2txt turns it back into text.
+//
+// Only the main loop may log, there's no locking.
+//
+// Bytes with bit 7 set start an event, so a decoder can join the
+// stream at any point. Varint bytes carry 6 bits, low bits first,
+// with bit 6 set when more follow.
+
+#include "pico/stdlib.h"
+
+// ID, argument count, and format for the decoder. %u is decimal,
+// %x hex, and %k a CBM key name.
+#define TRACELOG_EVENTS(X)                                                    \
+    X(TRACELOG_DROPPED, 1, "dropped %u events")                               \
+    X(TRACELOG_BOOT, 6, "boot: main %uus, kb_init +%uus, first scan +%uus, "  \
+                        "usb_init +%uus, mounted %uus, first report +%uus")   \
+    X(TRACELOG_WAKE, 3, "wake: remote wakeup accepted %u, signalled after "   \
+                        "%uus, resumed after %uus")                           \
+    X(TRACELOG_SOF, 5, "sof: synced %u, report before SOF min %uus avg %uus " \
+                       "max %uus, %u late")                                   \
+    X(TRACELOG_KEY_DOWN, 1, "down %k")                                        \
+    X(TRACELOG_KEY_UP, 1, "up %k")                                            \
+    X(TRACELOG_DEFER, 1, "defer %k to the next report")                       \
+    X(TRACELOG_REPORT, 7, "report %x %x %x %x %x %x %x")                      \
+    X(TRACELOG_STAGE, 5, "stage %u strategy %u: %u calls, cycles avg %u "     \
+                         "max %u")                                            \
+    X(TRACELOG_STROBE, 4, "strobe to sample: %u strobes, cycles min %u "      \
+                          "avg %u max %u")
+
+#define TRACELOG_ENUM(id, args, format) id,
+enum tracelog_id
+{
+    TRACELOG_EVENTS(TRACELOG_ENUM)
+};
+
+#define TRACELOG_SIZE 4096 // power of 2
+#define TRACELOG_ARGS_MAX 8
+#define TRACELOG_EVENT_MAX (1 + 6 * (1 + TRACELOG_ARGS_MAX))
+
+extern uint8_t tracelog_buf[TRACELOG_SIZE];
+extern uint32_t tracelog_head;
+extern uint32_t tracelog_tail;
+extern uint32_t tracelog_last_us;
+extern uint32_t tracelog_dropped;
+
+void tracelog_flush_dropped(void);
+
+static inline uint32_t tracelog_varint(uint32_t head, uint32_t value)
+{
+    while (value >= 0x40)
+    {
+        tracelog_buf[head++ % TRACELOG_SIZE] = 0x40 | (value & 0x3F);
+        value >>= 6;
+    }
+    tracelog_buf[head++ % TRACELOG_SIZE] = value;
+    return head;
+}
+
+static inline void tracelog_event(uint8_t id, uint count, const uint32_t *args)
+{
+    // Room for this event and a count of any dropped before it
+    if (tracelog_head - tracelog_tail > TRACELOG_SIZE - 2 * TRACELOG_EVENT_MAX)
+    {
+        tracelog_dropped++;
+        return;
+    }
+    if (tracelog_dropped)
+        tracelog_flush_dropped();
+    uint32_t now = time_us_32();
+    uint32_t head = tracelog_head;
+    tracelog_buf[head++ % TRACELOG_SIZE] = 0x80 | id;
+    head = tracelog_varint(head, now - tracelog_last_us);
+    for (uint i = 0; i < count; i++)
+        head = tracelog_varint(head, args[i]);
+    tracelog_last_us = now;
+    tracelog_head = head;
+}
+
+// TRACELOG(TRACELOG_KEY_DOWN, idx)
+#define TRACELOG(id, ...)                                               \
+    tracelog_event(id, sizeof((uint32_t[]){__VA_ARGS__}) / sizeof(uint32_t), \
+                   (uint32_t[]){__VA_ARGS__})
+
+// Reading side, for the DMA or a host. Returns how many bytes are
+// waiting in one piece, up to the end of the ring.
+uint tracelog_peek(const uint8_t **data);
+void tracelog_consume(uint len);
+
+#endif
@@ -94,7 +94,11 @@ extern "C"
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_HID 1
+#if defined(CBM_MOUSE) || defined(CBM_PADDLES)
+#define CFG_TUD_HID 3 // keyboard, debug, mouse or paddles
+#else
+#define CFG_TUD_HID 2 // keyboard, debug
+#endif
 #define CFG_TUD_CDC 0
 #define CFG_TUD_MSC 0
 #define CFG_TUD_MIDI 0
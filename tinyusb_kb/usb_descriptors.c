@@ -75,11 +75,75 @@ uint8_t const desc_hid_keyboard_report[] =
     {
         TUD_HID_REPORT_DESC_KEYBOARD()};
 
+// Vendor defined feature reports for diagnostics, 63 bytes after the ID
+#define DEBUG_FEATURE(report_id)                                 \
+    HID_REPORT_ID(report_id)                                     \
+    HID_USAGE(report_id),                                        \
+        HID_LOGICAL_MIN(0),                                      \
+        HID_LOGICAL_MAX_N(0xFF, 2),                              \
+        HID_REPORT_SIZE(8),                                      \
+        HID_REPORT_COUNT(63),                                    \
+        HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE)
+
+uint8_t const desc_hid_debug_report[] =
+    {
+        HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2),
+        HID_USAGE(0x01),
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),
+        DEBUG_FEATURE(REPORT_ID_CAPTURE),
+        DEBUG_FEATURE(REPORT_ID_PARAMS),
+        DEBUG_FEATURE(REPORT_ID_HEALTH),
+        HID_COLLECTION_END};
+
+#ifdef CBM_MOUSE
+uint8_t const desc_hid_mouse_report[] =
+    {
+        TUD_HID_REPORT_DESC_MOUSE()};
+#endif
+
+#ifdef CBM_PADDLES
+// Two paddles as X and Y of a joystick, then their buttons
+uint8_t const desc_hid_paddles_report[] =
+    {
+        HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),
+        HID_USAGE(HID_USAGE_DESKTOP_JOYSTICK),
+        HID_COLLECTION(HID_COLLECTION_APPLICATION),
+        HID_USAGE(HID_USAGE_DESKTOP_X),
+        HID_USAGE(HID_USAGE_DESKTOP_Y),
+        HID_LOGICAL_MIN(0),
+        HID_LOGICAL_MAX_N(255, 2),
+        HID_REPORT_SIZE(8),
+        HID_REPORT_COUNT(2),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+        HID_USAGE_PAGE(HID_USAGE_PAGE_BUTTON),
+        HID_USAGE_MIN(1),
+        HID_USAGE_MAX(2),
+        HID_LOGICAL_MIN(0),
+        HID_LOGICAL_MAX(1),
+        HID_REPORT_SIZE(1),
+        HID_REPORT_COUNT(2),
+        HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+        HID_REPORT_SIZE(6),
+        HID_REPORT_COUNT(1),
+        HID_INPUT(HID_CONSTANT),
+        HID_COLLECTION_END};
+#endif
+
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
+    if (instance == ITF_NUM_DEBUG)
+        return desc_hid_debug_report;
+#ifdef CBM_MOUSE
+    if (instance == ITF_NUM_MOUSE)
+        return desc_hid_mouse_report;
+#endif
+#ifdef CBM_PADDLES
+    if (instance == ITF_NUM_PADDLES)
+        return desc_hid_paddles_report;
+#endif
     return desc_hid_keyboard_report;
 }
 
@@ -87,8 +151,11 @@ uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN)
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + ITF_NUM_TOTAL * TUD_HID_DESC_LEN)
 #define EPNUM_KEYBOARD 0x81
+#define EPNUM_DEBUG 0x82
+#define EPNUM_MOUSE 0x83
+#define EPNUM_PADDLES 0x84
 
 uint8_t const desc_configuration[] =
     {
@@ -96,7 +163,14 @@ uint8_t const desc_configuration[] =
         TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
 
         // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-        TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_keyboard_report), EPNUM_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, 8),
+        TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 0, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_keyboard_report), EPNUM_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, 1),
+        TUD_HID_DESCRIPTOR(ITF_NUM_DEBUG, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_debug_report), EPNUM_DEBUG, CFG_TUD_HID_EP_BUFSIZE, 10),
+#ifdef CBM_MOUSE
+        TUD_HID_DESCRIPTOR(ITF_NUM_MOUSE, 0, HID_ITF_PROTOCOL_MOUSE, sizeof(desc_hid_mouse_report), EPNUM_MOUSE, CFG_TUD_HID_EP_BUFSIZE, 1),
+#endif
+#ifdef CBM_PADDLES
+        TUD_HID_DESCRIPTOR(ITF_NUM_PADDLES, 0, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_paddles_report), EPNUM_PADDLES, CFG_TUD_HID_EP_BUFSIZE, 1),
+#endif
 };
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
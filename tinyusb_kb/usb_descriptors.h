@@ -28,7 +28,23 @@
 enum
 {
     ITF_NUM_KEYBOARD,
+    ITF_NUM_DEBUG,
+#ifdef CBM_MOUSE
+    ITF_NUM_MOUSE,
+#endif
+#ifdef CBM_PADDLES
+    ITF_NUM_PADDLES,
+#endif
     ITF_NUM_TOTAL
 };
 
+// Feature reports on the vendor defined debug interface
+enum
+{
+    REPORT_ID_CAPTURE = 1,
+    REPORT_ID_PARAMS,
+    REPORT_ID_HEALTH,
+    REPORT_ID_COUNT
+};
+
 #endif